@@ -11,6 +11,11 @@
 // class, or during register allocation to model liveness of a physical
 // register.
 //
+// The segments are kept in an IntervalMap B+-tree by default. With
+// -flat-live-interval-unions they are kept in a sorted array instead, which
+// makes the interference scans walk contiguous memory at the price of linear
+// time insertion and removal.
+//
 //===----------------------------------------------------------------------===//
 
 #ifndef LLVM_CODEGEN_LIVEINTERVALUNION_H
@@ -45,6 +50,15 @@ class LiveIntervalUnion {
   // Mapping SlotIndex intervals to virtual register numbers.
   using LiveSegments = IntervalMap<SlotIndex, const LiveInterval *>;
 
+  // The same set as a sorted array of disjoint segments. Adjacent segments of
+  // one register are not coalesced.
+  struct FlatSegment {
+    SlotIndex Start;
+    SlotIndex Stop;
+    const LiveInterval *VirtReg;
+  };
+  using FlatSegments = SmallVector<FlatSegment, 0>;
+
 public:
   // SegmentIter can advance to the next segment ordered by starting position
   // which may belong to a different live virtual register. We also must be able
@@ -54,15 +68,72 @@ public:
   /// Const version of SegmentIter.
   using ConstSegmentIter = LiveSegments::const_iterator;
 
+  /// The iterator over a union with flat storage. It has the interface of
+  /// ConstSegmentIter, so code that scans unions can be written once for both
+  /// and choose the storage once per scan.
+  class FlatSegmentIter {
+    const FlatSegments *Flat = nullptr;
+    unsigned I = 0;
+
+    const FlatSegment &get() const {
+      assert(valid() && "Dereferencing an invalid iterator");
+      return (*Flat)[I];
+    }
+
+  public:
+    FlatSegmentIter() = default;
+
+    /// Attach the iterator to \p Union, positioned at its end.
+    void setUnion(const LiveIntervalUnion &Union) {
+      assert(Union.isFlat() && "Union uses the tree storage");
+      Flat = &Union.Flat;
+      I = Flat->size();
+    }
+
+    bool valid() const { return Flat && I < Flat->size(); }
+    SlotIndex start() const { return get().Start; }
+    SlotIndex stop() const { return get().Stop; }
+    const LiveInterval *value() const { return get().VirtReg; }
+
+    FlatSegmentIter &operator++() {
+      ++I;
+      return *this;
+    }
+    FlatSegmentIter &operator--() {
+      --I;
+      return *this;
+    }
+
+    /// Move to the first segment with stop > X. This is a full search, the
+    /// current position is ignored.
+    void find(SlotIndex X) {
+      I = 0;
+      advanceTo(X);
+    }
+
+    /// Move to the first segment with stop > X, searching forward from the
+    /// current position.
+    void advanceTo(SlotIndex X);
+  };
+
   // LiveIntervalUnions share an external allocator.
   using Allocator = LiveSegments::Allocator;
 
 private:
   unsigned Tag = 0;       // unique tag for current contents.
+  bool UseFlat;           // store the segments in Flat instead of Segments.
   LiveSegments Segments;  // union of virtual reg segments
+  FlatSegments Flat;
 
 public:
-  explicit LiveIntervalUnion(Allocator &a) : Segments(a) {}
+  // The storage is chosen by -flat-live-interval-unions.
+  explicit LiveIntervalUnion(Allocator &a);
+  LiveIntervalUnion(Allocator &a, bool UseFlat)
+      : UseFlat(UseFlat), Segments(a) {}
+
+  /// Return true if the segments are stored in a sorted array. Such a union
+  /// is scanned with FlatSegmentIter, the others with SegmentIter.
+  bool isFlat() const { return UseFlat; }
 
   // Iterate over all segments in the union of live virtual registers ordered
   // by their starting position.
@@ -73,9 +144,27 @@ public:
   ConstSegmentIter end() const { return Segments.end(); }
   ConstSegmentIter find(SlotIndex x) const { return Segments.find(x); }
 
-  bool empty() const { return Segments.empty(); }
-  SlotIndex startIndex() const { return Segments.start(); }
-  SlotIndex endIndex() const { return Segments.stop(); }
+  // The same for a union with flat storage.
+  FlatSegmentIter flatBegin() const {
+    FlatSegmentIter I;
+    I.setUnion(*this);
+    I.find(SlotIndex());
+    return I;
+  }
+  FlatSegmentIter flatFind(SlotIndex x) const {
+    FlatSegmentIter I;
+    I.setUnion(*this);
+    I.find(x);
+    return I;
+  }
+
+  bool empty() const { return UseFlat ? Flat.empty() : Segments.empty(); }
+  SlotIndex startIndex() const {
+    return UseFlat ? Flat.front().Start : Segments.start();
+  }
+  SlotIndex endIndex() const {
+    return UseFlat ? Flat.back().Stop : Segments.stop();
+  }
 
   // Provide public access to the underlying map to allow overlap iteration.
   using Map = LiveSegments;
@@ -94,7 +183,11 @@ public:
   void extract(const LiveInterval &VirtReg, const LiveRange &Range);
 
   // Remove all inserted virtual registers.
-  void clear() { Segments.clear(); ++Tag; }
+  void clear() {
+    Segments.clear();
+    Flat.clear();
+    ++Tag;
+  }
 
   // Print union, using TRI to translate register names
   void print(raw_ostream &OS, const TargetRegisterInfo *TRI) const;
@@ -114,6 +207,7 @@ public:
     const LiveRange *LR = nullptr;
     LiveRange::const_iterator LRI;  ///< current position in LR
     ConstSegmentIter LiveUnionI;    ///< current position in LiveUnion
+    FlatSegmentIter FlatLiveUnionI; ///< the same, for flat storage
     SmallVector<const LiveInterval *, 4> InterferingVRegs;
     bool CheckedFirstInterference = false;
     bool SeenAllInterferences = false;
@@ -123,6 +217,9 @@ public:
     // Count the virtual registers in this union that interfere with this
     // query's live virtual register, up to maxInterferingRegs.
     unsigned collectInterferingVRegs(unsigned MaxInterferingRegs);
+    template <typename IterT>
+    unsigned collectInterferingVRegs(IterT &UnionI,
+                                     unsigned MaxInterferingRegs);
 
     // Was this virtual register visited during collectInterferingVRegs?
     bool isSeenInterference(const LiveInterval *VirtReg) const;
@@ -31,10 +31,13 @@
 #include "llvm/CodeGen/TargetRegisterInfo.h"
 #include "llvm/MC/LaneBitmask.h"
 #include "llvm/Support/CommandLine.h"
+#include "llvm/Support/Allocator.h"
 #include "llvm/Support/Compiler.h"
 #include "llvm/Support/ErrorHandling.h"
+#include "llvm/Support/Recycler.h"
 #include <cassert>
 #include <cstdint>
+#include <memory>
 #include <utility>
 
 namespace llvm {
@@ -67,6 +70,17 @@ class LiveIntervals {
   /// Special pool allocator for VNInfo's (LiveInterval val#).
   VNInfo::Allocator VNInfoAllocator;
 
+  /// The memory of the LiveInterval objects of virtual registers. Removed
+  /// intervals are recycled, and everything is released at once by clear().
+  BumpPtrAllocator IntervalAllocator;
+  Recycler<LiveInterval> IntervalRecycler;
+  /// The number of removed intervals whose memory is waiting to be reused.
+  unsigned NumRecyclable = 0;
+
+  /// The allocators of the tasks that computed live intervals in parallel.
+  /// Their VNInfos are freed together with the ones in VNInfoAllocator.
+  SmallVector<std::unique_ptr<VNInfo::Allocator>, 0> TaskVNInfoAllocators;
+
   /// Live interval pointers for all the virtual registers.
   IndexedMap<LiveInterval *, VirtReg2IndexFunctor> VirtRegIntervals;
 
@@ -170,7 +184,7 @@ public:
   /// Interval removal.
   void removeInterval(Register Reg) {
     auto &Interval = VirtRegIntervals[Reg];
-    delete Interval;
+    destroyInterval(Interval);
     Interval = nullptr;
   }
 
@@ -399,6 +413,15 @@ public:
   LLVM_ABI bool checkRegMaskInterference(const LiveInterval &LI,
                                          BitVector &UsableRegs);
 
+  /// Return the number of register mask instructions, i.e. calls, that \p LR
+  /// is live at. A live range defined by a call is live at it, a live range
+  /// killed by a call is not. This takes O(log(calls)) time per segment.
+  LLVM_ABI unsigned getNumCallsCrossed(const LiveRange &LR) const;
+
+  /// Return true if \p LR is live at any register mask instruction. This is
+  /// the same as getNumCallsCrossed(LR) != 0, but stops at the first call.
+  LLVM_ABI bool crossesCall(const LiveRange &LR) const;
+
   // Register unit functions.
   //
   // Fixed interference occurs when MachineInstrs use physregs directly
@@ -470,6 +493,10 @@ private:
   /// Compute live intervals for all virtual registers.
   void computeVirtRegs();
 
+  /// Compute the live intervals of all virtual registers on the parallel
+  /// executor.
+  void computeVirtRegsInParallel();
+
   /// Compute RegMaskSlots and RegMaskBits.
   void computeRegMasks();
 
@@ -483,7 +510,15 @@ private:
   bool computeDeadValues(LiveInterval &LI,
                          SmallVectorImpl<MachineInstr *> *dead);
 
-  LLVM_ABI static LiveInterval *createInterval(Register Reg);
+  LLVM_ABI LiveInterval *createInterval(Register Reg);
+
+  void destroyInterval(LiveInterval *LI) {
+    if (!LI)
+      return;
+    LI->~LiveInterval();
+    IntervalRecycler.Deallocate(IntervalAllocator, LI);
+    ++NumRecyclable;
+  }
 
   void printInstrs(raw_ostream &O) const;
   void dumpInstrs() const;
@@ -0,0 +1,109 @@
+//===- llvm/CodeGen/MaxLive.h - Maximal register pressure -------*- C++ -*-===//
+//
+// Part of the LLVM Project, under the Apache License v2.0 with LLVM Exceptions.
+// See https://llvm.org/LICENSE.txt for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+//
+//===----------------------------------------------------------------------===//
+//
+// The MaxLive analysis computes, for every register class, the largest number
+// of virtual registers of that class that are live at the same program point,
+// both over the whole function and within each basic block.
+//
+// The result is exact with respect to LiveIntervals: a live range only counts
+// where it has a segment, so holes in a live interval don't add pressure. For
+// a function in SSA form, the function maximum is the number of registers a
+// chordal coloring needs.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef LLVM_CODEGEN_MAXLIVE_H
+#define LLVM_CODEGEN_MAXLIVE_H
+
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/CodeGen/MachineFunctionPass.h"
+#include "llvm/IR/PassManager.h"
+#include "llvm/Support/Compiler.h"
+#include <utility>
+
+namespace llvm {
+
+class LiveIntervals;
+class MachineBasicBlock;
+class MachineDominatorTree;
+class MachineFunction;
+class raw_ostream;
+class TargetRegisterClass;
+class TargetRegisterInfo;
+
+class MaxLive {
+  const MachineFunction *MF = nullptr;
+  const TargetRegisterInfo *TRI = nullptr;
+
+  /// Function maximum of each register class, indexed by class ID.
+  SmallVector<unsigned, 32> FunctionMaxLive;
+
+  /// For each block, the (class ID, maximum) pairs of the classes that have
+  /// live virtual registers in the block, sorted by class ID.
+  SmallVector<SmallVector<std::pair<unsigned, unsigned>, 4>, 0> BlockMaxLive;
+
+public:
+  /// Compute the maxima of \p MF from the live intervals of its virtual
+  /// registers. Blocks that are unreachable from the entry are ignored.
+  LLVM_ABI void compute(const MachineFunction &MF, const LiveIntervals &LIS,
+                        const MachineDominatorTree &MDT);
+
+  /// Return the largest number of simultaneously live virtual registers of
+  /// class \p RC in the function.
+  LLVM_ABI unsigned getMaxLive(const TargetRegisterClass &RC) const;
+
+  /// Return the largest number of simultaneously live virtual registers of
+  /// class \p RC in \p MBB.
+  LLVM_ABI unsigned getMaxLive(const MachineBasicBlock &MBB,
+                               const TargetRegisterClass &RC) const;
+
+  LLVM_ABI void releaseMemory();
+  LLVM_ABI void print(raw_ostream &OS) const;
+};
+
+class LLVM_ABI MaxLiveWrapperPass : public MachineFunctionPass {
+  MaxLive ML;
+
+public:
+  static char ID;
+
+  MaxLiveWrapperPass();
+
+  MaxLive &getMaxLive() { return ML; }
+  const MaxLive &getMaxLive() const { return ML; }
+
+  void getAnalysisUsage(AnalysisUsage &AU) const override;
+  bool runOnMachineFunction(MachineFunction &MF) override;
+  void releaseMemory() override { ML.releaseMemory(); }
+  void print(raw_ostream &OS, const Module * = nullptr) const override;
+};
+
+class MaxLiveAnalysis : public AnalysisInfoMixin<MaxLiveAnalysis> {
+  friend AnalysisInfoMixin<MaxLiveAnalysis>;
+  LLVM_ABI static AnalysisKey Key;
+
+public:
+  using Result = MaxLive;
+
+  LLVM_ABI Result run(MachineFunction &MF,
+                      MachineFunctionAnalysisManager &MFAM);
+};
+
+class MaxLivePrinterPass : public PassInfoMixin<MaxLivePrinterPass> {
+  raw_ostream &OS;
+
+public:
+  explicit MaxLivePrinterPass(raw_ostream &OS) : OS(OS) {}
+  LLVM_ABI PreservedAnalyses run(MachineFunction &MF,
+                                 MachineFunctionAnalysisManager &MFAM);
+  static bool isRequired() { return true; }
+};
+
+} // end namespace llvm
+
+#endif // LLVM_CODEGEN_MAXLIVE_H
@@ -0,0 +1,74 @@
+//===- llvm/CodeGen/PackedLiveRange.h - Live range search copy --*- C++ -*-===//
+//
+// Part of the LLVM Project, under the Apache License v2.0 with LLVM Exceptions.
+// See https://llvm.org/LICENSE.txt for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+//
+//===----------------------------------------------------------------------===//
+//
+// A PackedLiveRange is a read-only copy of the segments of a LiveRange, with
+// the segment bounds stored as raw slot index numbers in two arrays. Comparing
+// two SlotIndex values loads the number of each from its IndexListEntry, so a
+// search over LiveRange::segments misses the cache on every probe. Searching
+// the copy compares integers that sit next to each other: a branchless binary
+// search narrows the range down to a few segments, and a counting loop over
+// those compiles to vector compares.
+//
+// The numbers are only meaningful as long as SlotIndexes doesn't renumber, so
+// a copy is only valid while neither the live range nor the slot index
+// numbering changes. It suits clients that make many queries against live
+// ranges that stay fixed in between, like interference checks between
+// assigned live ranges.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef LLVM_CODEGEN_PACKEDLIVERANGE_H
+#define LLVM_CODEGEN_PACKEDLIVERANGE_H
+
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/CodeGen/SlotIndexes.h"
+#include "llvm/Support/Compiler.h"
+#include <cstdint>
+
+namespace llvm {
+
+class LiveRange;
+
+class PackedLiveRange {
+  /// The start and end of each segment, in segment order.
+  SmallVector<uint32_t, 4> Starts;
+  SmallVector<uint32_t, 4> Ends;
+
+  /// Return the number of segments that end at or before \p Idx.
+  LLVM_ABI unsigned findRaw(uint32_t Idx) const;
+
+public:
+  PackedLiveRange() = default;
+  explicit PackedLiveRange(const LiveRange &LR) { assign(LR); }
+
+  /// Replace the contents with the current segments of \p LR.
+  LLVM_ABI void assign(const LiveRange &LR);
+
+  bool empty() const { return Starts.empty(); }
+  unsigned size() const { return Starts.size(); }
+
+  /// Return the position of the first segment that ends after \p Pos, like
+  /// LiveRange::find, or size() if there is none.
+  unsigned find(SlotIndex Pos) const { return findRaw(Pos.getIndex()); }
+
+  /// Return true if the live range is live at \p Pos.
+  bool liveAt(SlotIndex Pos) const {
+    unsigned I = find(Pos);
+    return I != size() && Starts[I] <= Pos.getIndex();
+  }
+
+  /// Return true if the live range has a segment that overlaps [Start, End).
+  LLVM_ABI bool overlaps(SlotIndex Start, SlotIndex End) const;
+
+  /// Return true if the two live ranges overlap, like LiveRange::overlaps.
+  LLVM_ABI bool overlaps(const PackedLiveRange &Other) const;
+};
+
+} // end namespace llvm
+
+#endif // LLVM_CODEGEN_PACKEDLIVERANGE_H
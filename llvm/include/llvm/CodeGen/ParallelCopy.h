@@ -0,0 +1,88 @@
+//===- llvm/CodeGen/ParallelCopy.h - Parallel copy lowering -----*- C++ -*-===//
+//
+// Part of the LLVM Project, under the Apache License v2.0 with LLVM Exceptions.
+// See https://llvm.org/LICENSE.txt for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+//
+//===----------------------------------------------------------------------===//
+//
+// A parallel copy assigns a set of destination registers from a set of source
+// registers at the same time, as PHIs and live range splits do. This file
+// provides the lowering of a parallel copy of physical registers to a sequence
+// of ordinary copies and swaps.
+//
+// Copies whose destination is not read by another copy are emitted first.
+// What remains are disjoint cycles; a cycle of N registers is broken either
+// with N - 1 swaps or with N + 1 copies through a scratch register, whichever
+// is cheaper for the target.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef LLVM_CODEGEN_PARALLELCOPY_H
+#define LLVM_CODEGEN_PARALLELCOPY_H
+
+#include "llvm/ADT/ArrayRef.h"
+#include "llvm/ADT/STLFunctionalExtras.h"
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/CodeGen/MachineBasicBlock.h"
+#include "llvm/MC/MCRegister.h"
+#include "llvm/Support/Compiler.h"
+#include <optional>
+#include <utility>
+
+namespace llvm {
+
+class DebugLoc;
+class MachineBlockFrequencyInfo;
+
+/// One step of a sequentialized parallel copy.
+struct ParallelCopyStep {
+  enum StepKind {
+    Copy, ///< Dst = Src.
+    Swap, ///< Exchange the contents of Dst and Src.
+  };
+  StepKind Kind;
+  unsigned Dst;
+  unsigned Src;
+
+  bool operator==(const ParallelCopyStep &Other) const {
+    return Kind == Other.Kind && Dst == Other.Dst && Src == Other.Src;
+  }
+};
+
+/// Lower the parallel copy \p Copies, given as (Dst, Src) pairs, to a sequence
+/// of steps with the same effect. Every destination must appear once, and no
+/// register may partially overlap another one. A source may be copied to
+/// several destinations.
+///
+/// \p SwapCost returns the cost of swapping two registers, in units of one
+/// register copy, or 0 if they can't be swapped. \p Scratch is a register that is
+/// free across the copy, or 0 if there is none. Return std::nullopt if a cycle
+/// can be broken neither way.
+LLVM_ABI std::optional<SmallVector<ParallelCopyStep, 8>>
+sequentializeParallelCopy(ArrayRef<std::pair<unsigned, unsigned>> Copies,
+                          function_ref<unsigned(unsigned, unsigned)> SwapCost,
+                          unsigned Scratch = 0);
+
+/// Emit the parallel copy \p Copies of physical registers before \p I, using
+/// TargetInstrInfo::swapPhysRegs() where the target supports it and \p Scratch
+/// otherwise. Return false, without changing anything, if a cycle cannot be
+/// broken.
+LLVM_ABI bool
+emitParallelCopy(MachineBasicBlock &MBB, MachineBasicBlock::iterator I,
+                 const DebugLoc &DL,
+                 ArrayRef<std::pair<MCRegister, MCRegister>> Copies,
+                 MCRegister Scratch = MCRegister());
+
+/// Return true if the copies needed on the edges from \p Preds into \p MBB
+/// execute less often as a single copy at the entry of \p MBB than as one copy
+/// at the end of each predecessor. The caller must make sure the copy is
+/// harmless on the remaining incoming edges.
+LLVM_ABI bool
+isParallelCopyCheaperAtEntry(const MachineBasicBlock &MBB,
+                             ArrayRef<const MachineBasicBlock *> Preds,
+                             const MachineBlockFrequencyInfo &MBFI);
+
+} // end namespace llvm
+
+#endif // LLVM_CODEGEN_PARALLELCOPY_H
@@ -230,6 +230,9 @@ LLVM_ABI FunctionPass *createFastRegisterAllocator(RegAllocFilterFunc F,
 LLVM_ABI FunctionPass *createBasicRegisterAllocator();
 LLVM_ABI FunctionPass *createBasicRegisterAllocator(RegAllocFilterFunc F);
 
+/// SSA register allocation pass - This pass colors live ranges in dominator
+/// tree order and spills instead of evicting when it runs out of registers.
+///
 LLVM_ABI FunctionPass *createSSARegisterAllocator();
 LLVM_ABI FunctionPass *createSSARegisterAllocator(RegAllocFilterFunc F);
 
@@ -618,6 +621,10 @@ LLVM_ABI FunctionPass *createX86LowerAMXIntrinsicsPass();
 /// otherwise this does nothing
 LLVM_ABI FunctionPass *createRegAllocScoringPass();
 
+/// Reports the frequency-weighted RegAllocScore of each function as an
+/// analysis remark and as statistics, whichever allocator ran.
+LLVM_ABI extern char &RegAllocScoreReportID;
+
 /// JMC instrument pass.
 LLVM_ABI ModulePass *createJMCInstrumenterPass();
 
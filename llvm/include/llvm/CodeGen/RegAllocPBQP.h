@@ -27,6 +27,7 @@
 #include "llvm/Support/ErrorHandling.h"
 #include <algorithm>
 #include <cassert>
+#include <chrono>
 #include <cstddef>
 #include <limits>
 #include <memory>
@@ -287,7 +288,12 @@ public:
 
   using Graph = PBQP::Graph<RegAllocSolverImpl>;
 
-  RegAllocSolverImpl(Graph &G) : G(G) {}
+  using TimePoint = std::chrono::steady_clock::time_point;
+
+  /// Once \p Deadline has passed, the nodes that are not provably allocatable
+  /// are reduced in node order instead of cheapest spill cost first.
+  RegAllocSolverImpl(Graph &G, TimePoint Deadline = TimePoint::max())
+      : G(G), Deadline(Deadline) {}
 
   Solution solve() {
     G.setSolver(*this);
@@ -462,8 +468,10 @@ private:
         NodeStack.push_back(NId);
         G.disconnectAllNeighborsFromNode(NId);
       } else if (!NotProvablyAllocatableNodes.empty()) {
-        NodeSet::iterator NItr = llvm::min_element(NotProvablyAllocatableNodes,
-                                                   SpillCostComparator(G));
+        NodeSet::iterator NItr =
+            isPastDeadline() ? NotProvablyAllocatableNodes.begin()
+                             : llvm::min_element(NotProvablyAllocatableNodes,
+                                                 SpillCostComparator(G));
         NodeId NId = *NItr;
         NotProvablyAllocatableNodes.erase(NItr);
         NodeStack.push_back(NId);
@@ -491,7 +499,19 @@ private:
     const Graph& G;
   };
 
+  /// Return true once the deadline has passed. The clock is only read every
+  /// few calls.
+  bool isPastDeadline() {
+    if (PastDeadline || Deadline == TimePoint::max() || ++NumChecks % 64)
+      return PastDeadline;
+    PastDeadline = std::chrono::steady_clock::now() >= Deadline;
+    return PastDeadline;
+  }
+
   Graph& G;
+  TimePoint Deadline;
+  unsigned NumChecks = 0;
+  bool PastDeadline = false;
   using NodeSet = std::set<NodeId>;
   NodeSet OptimallyReducibleNodes;
   NodeSet ConservativelyAllocatableNodes;
@@ -517,10 +537,13 @@ public:
   void printDot(raw_ostream &OS) const;
 };
 
-inline Solution solve(PBQPRAGraph& G) {
+inline Solution
+solve(PBQPRAGraph &G,
+      RegAllocSolverImpl::TimePoint Deadline =
+          RegAllocSolverImpl::TimePoint::max()) {
   if (G.empty())
     return Solution();
-  RegAllocSolverImpl RegAllocSolver(G);
+  RegAllocSolverImpl RegAllocSolver(G, Deadline);
   return RegAllocSolver.solve();
 }
 
@@ -0,0 +1,84 @@
+//===- llvm/CodeGen/RegAllocStats.h - Allocation statistics -----*- C++ -*-===//
+//
+// Part of the LLVM Project, under the Apache License v2.0 with LLVM Exceptions.
+// See https://llvm.org/LICENSE.txt for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+//
+//===----------------------------------------------------------------------===//
+//
+// Passes that record the outcome of register allocation for each machine
+// function, for tools that compare register allocators.
+//
+// A tool adds a RegAllocStatsSink to its pass manager and inserts the timer
+// pass before the register allocator and the collector pass after the virtual
+// register rewriter, e.g. with TargetPassConfig::insertPass(). The collector
+// then appends one record per function to the vector owned by the tool.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef LLVM_CODEGEN_REGALLOCSTATS_H
+#define LLVM_CODEGEN_REGALLOCSTATS_H
+
+#include "llvm/Pass.h"
+#include "llvm/Support/Compiler.h"
+#include <string>
+#include <vector>
+
+namespace llvm {
+
+class MachineBlockFrequencyInfo;
+class MachineFunction;
+
+/// The spill code and copies left in a function after register allocation.
+struct RegAllocFunctionStats {
+  std::string Name;
+  /// Stores to spill slots, including folded ones.
+  unsigned Spills = 0;
+  /// Loads from spill slots, including folded ones.
+  unsigned Reloads = 0;
+  /// Copies that survived rewriting.
+  unsigned Copies = 0;
+  /// The RegAllocScore of the function, weighted by block frequency.
+  double Score = 0.0;
+  /// Wall time since the timer pass ran, in seconds, or 0 if it didn't run.
+  double WallTime = 0.0;
+};
+
+/// Count the spill code and copies in the allocated function \p MF and
+/// compute its score.
+LLVM_ABI RegAllocFunctionStats
+computeRegAllocStats(const MachineFunction &MF,
+                     const MachineBlockFrequencyInfo &MBFI);
+
+/// Owns the destination of the records, and the start time of the current
+/// allocation.
+class LLVM_ABI RegAllocStatsSink : public ImmutablePass {
+  std::vector<RegAllocFunctionStats> *Records;
+  double StartTime = 0.0;
+  bool Started = false;
+
+public:
+  static char ID;
+
+  /// Records are appended to \p Records, or dropped if it is null.
+  explicit RegAllocStatsSink(
+      std::vector<RegAllocFunctionStats> *Records = nullptr);
+
+  void startTimer();
+
+  /// Add \p Stats, with the wall time since startTimer(). A second record for
+  /// the same function replaces the first, so the collector may run after
+  /// each of several rewriters.
+  void record(RegAllocFunctionStats Stats);
+};
+
+/// Starts the allocation timer of the RegAllocStatsSink.
+LLVM_ABI extern char &RegAllocStatsTimerID;
+
+/// Records the RegAllocFunctionStats of each function in the
+/// RegAllocStatsSink.
+LLVM_ABI extern char &RegAllocStatsCollectorID;
+
+} // end namespace llvm
+
+#endif // LLVM_CODEGEN_REGALLOCSTATS_H
@@ -0,0 +1,121 @@
+//===- llvm/CodeGen/SSALiveness.h - Liveness checks in SSA form -*- C++ -*-===//
+//
+// Part of the LLVM Project, under the Apache License v2.0 with LLVM Exceptions.
+// See https://llvm.org/LICENSE.txt for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+//
+//===----------------------------------------------------------------------===//
+//
+// The SSALiveness analysis answers whether a virtual register is live into or
+// out of a basic block without computing live intervals, following "Fast
+// Liveness Checking for SSA-Form Programs" by Boissinot et al.
+//
+// Only the CFG is analyzed up front: for every block q, the blocks reachable
+// from q once the back edges of a depth-first search are removed (R_q), and
+// the targets of the back edges that q can reach (T_q). A value defined in d is
+// live into q iff d strictly dominates q and some use is in R_t for a t in T_q
+// that d strictly dominates. The uses are read from MachineRegisterInfo at
+// query time, so the result stays valid as instructions are added or removed,
+// as long as the CFG doesn't change.
+//
+// The queries require each queried register to have a single definition that
+// dominates its uses. A PHI operand is a use at the end of its incoming block.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef LLVM_CODEGEN_SSALIVENESS_H
+#define LLVM_CODEGEN_SSALIVENESS_H
+
+#include "llvm/ADT/BitVector.h"
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/CodeGen/MachineFunctionPass.h"
+#include "llvm/CodeGen/Register.h"
+#include "llvm/IR/PassManager.h"
+#include "llvm/Support/Compiler.h"
+
+namespace llvm {
+
+class MachineBasicBlock;
+class MachineDominatorTree;
+class MachineFunction;
+class MachineRegisterInfo;
+class raw_ostream;
+
+class SSALiveness {
+  const MachineFunction *MF = nullptr;
+  const MachineRegisterInfo *MRI = nullptr;
+
+  /// Each block's interval [first, last] of preorder numbers of its subtree
+  /// in the dominator tree, or ~0u for blocks unreachable from the entry.
+  SmallVector<std::pair<unsigned, unsigned>, 0> DomRange;
+
+  /// R_q of each block, indexed by block number.
+  SmallVector<BitVector, 0> Reachable;
+
+  /// T_q of each block, sorted by dominator tree preorder.
+  SmallVector<SmallVector<unsigned, 4>, 0> Targets;
+
+  bool properlyDominates(unsigned A, unsigned B) const {
+    return DomRange[A].first < DomRange[B].first &&
+           DomRange[B].first <= DomRange[A].second;
+  }
+
+public:
+  /// Compute the reachability sets of \p MF. Blocks that are unreachable from
+  /// the entry have no live values.
+  LLVM_ABI void compute(const MachineFunction &MF,
+                        const MachineDominatorTree &MDT);
+
+  /// Return true if the value of \p Reg is live at the start of \p MBB. A
+  /// value defined by a PHI is not live into the PHI's block.
+  LLVM_ABI bool isLiveIn(Register Reg, const MachineBasicBlock &MBB) const;
+
+  /// Return true if the value of \p Reg is live at the end of \p MBB,
+  /// including as a PHI operand for a successor.
+  LLVM_ABI bool isLiveOut(Register Reg, const MachineBasicBlock &MBB) const;
+
+  LLVM_ABI void releaseMemory();
+  LLVM_ABI void print(raw_ostream &OS) const;
+};
+
+class LLVM_ABI SSALivenessWrapperPass : public MachineFunctionPass {
+  SSALiveness SL;
+
+public:
+  static char ID;
+
+  SSALivenessWrapperPass();
+
+  SSALiveness &getSSALiveness() { return SL; }
+  const SSALiveness &getSSALiveness() const { return SL; }
+
+  void getAnalysisUsage(AnalysisUsage &AU) const override;
+  bool runOnMachineFunction(MachineFunction &MF) override;
+  void releaseMemory() override { SL.releaseMemory(); }
+  void print(raw_ostream &OS, const Module * = nullptr) const override;
+};
+
+class SSALivenessAnalysis : public AnalysisInfoMixin<SSALivenessAnalysis> {
+  friend AnalysisInfoMixin<SSALivenessAnalysis>;
+  LLVM_ABI static AnalysisKey Key;
+
+public:
+  using Result = SSALiveness;
+
+  LLVM_ABI Result run(MachineFunction &MF,
+                      MachineFunctionAnalysisManager &MFAM);
+};
+
+class SSALivenessPrinterPass : public PassInfoMixin<SSALivenessPrinterPass> {
+  raw_ostream &OS;
+
+public:
+  explicit SSALivenessPrinterPass(raw_ostream &OS) : OS(OS) {}
+  LLVM_ABI PreservedAnalyses run(MachineFunction &MF,
+                                 MachineFunctionAnalysisManager &MFAM);
+  static bool isRequired() { return true; }
+};
+
+} // end namespace llvm
+
+#endif // LLVM_CODEGEN_SSALIVENESS_H
@@ -64,6 +64,7 @@ class raw_ostream;
 
   /// SlotIndex - An opaque wrapper around machine indexes.
   class SlotIndex {
+    friend class PackedLiveRange;
     friend class SlotIndexes;
 
     enum Slot {
@@ -337,6 +338,10 @@ class raw_ostream;
     /// Renumber locally after inserting curItr.
     LLVM_ABI void renumberIndexes(IndexList::iterator curItr);
 
+    /// Spread out the smallest window around curItr that is sparse enough.
+    /// Return the number of renumbered entries.
+    unsigned renumberWindow(IndexList::iterator curItr);
+
   public:
     SlotIndexes(SlotIndexes &&) = default;
 
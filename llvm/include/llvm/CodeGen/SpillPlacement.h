@@ -54,6 +54,11 @@ class SpillPlacement {
 
   std::unique_ptr<Node[]> nodes;
 
+  // Output value of each node, one of {-1, 0, 1}. Kept apart from the nodes
+  // so the update loop reads the values of the linked nodes from one small
+  // array.
+  std::unique_ptr<int8_t[]> NodeValues;
+
   // Nodes that are active in the current computation. Owned by the prepare()
   // caller.
   BitVector *ActiveNodes = nullptr;
@@ -174,6 +179,10 @@ private:
   void setThreshold(BlockFrequency Entry);
 
   bool update(unsigned n);
+
+  /// preferReg - Return true when node n prefers to be in a register.
+  /// Undecided nodes (value 0) go on the stack.
+  bool preferReg(unsigned n) const { return NodeValues[n] > 0; }
 };
 
 class SpillPlacementWrapperLegacy : public MachineFunctionPass {
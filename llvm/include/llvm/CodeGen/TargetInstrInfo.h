@@ -1084,6 +1084,21 @@ public:
     llvm_unreachable("Target didn't implement TargetInstrInfo::copyPhysReg!");
   }
 
+  /// Return the cost of exchanging the contents of \p RegA and \p RegB with
+  /// swapPhysRegs(), in units of one register copy, or 0 if the target can't
+  /// exchange them without a scratch register.
+  virtual unsigned getSwapPhysRegsCost(MCRegister RegA, MCRegister RegB) const {
+    return 0;
+  }
+
+  /// Emit instructions to exchange the contents of two physical registers.
+  /// Only called when getSwapPhysRegsCost() returns a non-zero cost.
+  virtual void swapPhysRegs(MachineBasicBlock &MBB,
+                            MachineBasicBlock::iterator MI, const DebugLoc &DL,
+                            MCRegister RegA, MCRegister RegB) const {
+    llvm_unreachable("Target didn't implement TargetInstrInfo::swapPhysRegs!");
+  }
+
   /// Allow targets to tell MachineVerifier whether a specific register
   /// MachineOperand can be used as part of PC-relative addressing.
   /// PC-relative addressing modes in many CISC architectures contain
@@ -228,6 +228,7 @@ LLVM_ABI void initializeMachineTraceMetricsWrapperPassPass(PassRegistry &);
 LLVM_ABI void initializeMachineUniformityInfoPrinterPassPass(PassRegistry &);
 LLVM_ABI void initializeMachineUniformityAnalysisPassPass(PassRegistry &);
 LLVM_ABI void initializeMachineVerifierLegacyPassPass(PassRegistry &);
+LLVM_ABI void initializeMaxLiveWrapperPassPass(PassRegistry &);
 LLVM_ABI void initializeMemoryDependenceWrapperPassPass(PassRegistry &);
 LLVM_ABI void initializeMemorySSAWrapperPassPass(PassRegistry &);
 LLVM_ABI void initializeMergeICmpsLegacyPassPass(PassRegistry &);
@@ -264,9 +265,9 @@ LLVM_ABI void initializeProcessImplicitDefsLegacyPass(PassRegistry &);
 LLVM_ABI void initializeProfileSummaryInfoWrapperPassPass(PassRegistry &);
 LLVM_ABI void initializePromoteLegacyPassPass(PassRegistry &);
 LLVM_ABI void initializeRABasicPass(PassRegistry &);
-LLVM_ABI void initializeRASSAPass(PassRegistry&); // <--- ADD THIS LINE
 LLVM_ABI void initializePseudoProbeInserterPass(PassRegistry &);
 LLVM_ABI void initializeRAGreedyLegacyPass(PassRegistry &);
+LLVM_ABI void initializeRASSAPass(PassRegistry &);
 LLVM_ABI void initializeReachingDefInfoWrapperPassPass(PassRegistry &);
 LLVM_ABI void initializeReassociateLegacyPassPass(PassRegistry &);
 LLVM_ABI void
@@ -274,7 +275,11 @@ initializeRegAllocEvictionAdvisorAnalysisLegacyPass(PassRegistry &);
 LLVM_ABI void initializeRegAllocFastPass(PassRegistry &);
 LLVM_ABI void
 initializeRegAllocPriorityAdvisorAnalysisLegacyPass(PassRegistry &);
+LLVM_ABI void initializeRegAllocScoreReportPass(PassRegistry &);
 LLVM_ABI void initializeRegAllocScoringPass(PassRegistry &);
+LLVM_ABI void initializeRegAllocStatsCollectorPass(PassRegistry &);
+LLVM_ABI void initializeRegAllocStatsSinkPass(PassRegistry &);
+LLVM_ABI void initializeRegAllocStatsTimerPass(PassRegistry &);
 LLVM_ABI void initializeRegBankSelectPass(PassRegistry &);
 LLVM_ABI void initializeRegToMemWrapperPassPass(PassRegistry &);
 LLVM_ABI void initializeRegUsageInfoCollectorLegacyPass(PassRegistry &);
@@ -292,6 +297,7 @@ LLVM_ABI void initializeReplaceWithVeclibLegacyPass(PassRegistry &);
 LLVM_ABI void initializeResetMachineFunctionPass(PassRegistry &);
 LLVM_ABI void initializeSCEVAAWrapperPassPass(PassRegistry &);
 LLVM_ABI void initializeSROALegacyPassPass(PassRegistry &);
+LLVM_ABI void initializeSSALivenessWrapperPassPass(PassRegistry &);
 LLVM_ABI void initializeSafeStackLegacyPassPass(PassRegistry &);
 LLVM_ABI void initializeSafepointIRVerifierPass(PassRegistry &);
 LLVM_ABI void initializeSelectOptimizePass(PassRegistry &);
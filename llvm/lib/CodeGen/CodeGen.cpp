@@ -100,6 +100,7 @@ void llvm::initializeCodeGen(PassRegistry &Registry) {
   initializeMIR2VecVocabPrinterLegacyPassPass(Registry);
   initializeMachineUniformityInfoPrinterPassPass(Registry);
   initializeMachineVerifierLegacyPassPass(Registry);
+  initializeMaxLiveWrapperPassPass(Registry);
   initializeObjCARCContractLegacyPassPass(Registry);
   initializeOptimizePHIsLegacyPass(Registry);
   initializePEILegacyPass(Registry);
@@ -113,16 +114,21 @@ void llvm::initializeCodeGen(PassRegistry &Registry) {
   initializePreISelIntrinsicLoweringLegacyPassPass(Registry);
   initializeProcessImplicitDefsLegacyPass(Registry);
   initializeRABasicPass(Registry);
-  initializeRASSAPass(Registry); // <--- ADD THIS LINE
   initializeRAGreedyLegacyPass(Registry);
+  initializeRASSAPass(Registry);
   initializeReachingDefInfoWrapperPassPass(Registry);
   initializeRegAllocFastPass(Registry);
+  initializeRegAllocScoreReportPass(Registry);
+  initializeRegAllocStatsCollectorPass(Registry);
+  initializeRegAllocStatsSinkPass(Registry);
+  initializeRegAllocStatsTimerPass(Registry);
   initializeRegUsageInfoCollectorLegacyPass(Registry);
   initializeRegUsageInfoPropagationLegacyPass(Registry);
   initializeRegisterCoalescerLegacyPass(Registry);
   initializeRemoveLoadsIntoFakeUsesLegacyPass(Registry);
   initializeRemoveRedundantDebugValuesLegacyPass(Registry);
   initializeRenameIndependentSubregsLegacyPass(Registry);
+  initializeSSALivenessWrapperPassPass(Registry);
   initializeSafeStackLegacyPassPass(Registry);
   initializeSelectOptimizePass(Registry);
   initializeShadowStackGCLoweringPass(Registry);
@@ -12,12 +12,15 @@
 
 #include "InterferenceCache.h"
 #include "llvm/ADT/ArrayRef.h"
+#include "llvm/ADT/Statistic.h"
 #include "llvm/CodeGen/LiveIntervals.h"
 #include "llvm/CodeGen/MachineBasicBlock.h"
 #include "llvm/CodeGen/MachineFunction.h"
 #include "llvm/CodeGen/MachineOperand.h"
 #include "llvm/CodeGen/TargetRegisterInfo.h"
+#include "llvm/Support/CommandLine.h"
 #include "llvm/Support/ErrorHandling.h"
+#include <algorithm>
 #include <cassert>
 #include <cstdint>
 #include <tuple>
@@ -26,6 +29,18 @@ using namespace llvm;
 
 #define DEBUG_TYPE "regalloc"
 
+STATISTIC(NumCacheHits, "Number of interference cache hits");
+STATISTIC(NumCacheMisses, "Number of interference cache entries replaced");
+STATISTIC(NumCacheRevalidations,
+          "Number of interference cache entries invalidated by a union change");
+STATISTIC(NumBlockUpdates,
+          "Number of blocks whose interference was recomputed");
+
+static cl::opt<unsigned> InterferenceCacheEntries(
+    "interference-cache-entries", cl::Hidden, cl::init(0),
+    cl::desc("Number of interference cache entries, or 0 to use the size of "
+             "the largest allocation order"));
+
 // Static member used for null interference cursors.
 const InterferenceCache::BlockInterference
     InterferenceCache::Cursor::NoInterference;
@@ -50,34 +65,64 @@ void InterferenceCache::init(MachineFunction *mf,
                              LiveIntervalUnion *liuarray,
                              SlotIndexes *indexes,
                              LiveIntervals *lis,
-                             const TargetRegisterInfo *tri) {
+                             const TargetRegisterInfo *tri,
+                             unsigned NumOrderRegs) {
   MF = mf;
   LIUArray = liuarray;
   TRI = tri;
   reinitPhysRegEntries();
-  for (Entry &E : Entries)
+
+  // Region splitting looks at every register in the allocation order, so
+  // fewer entries than that evict each other on every live range.
+  unsigned NumBlocks = mf->getNumBlockIDs();
+  unsigned NumEntries = InterferenceCacheEntries;
+  if (!NumEntries) {
+    unsigned MemoryBound = MaxCacheBlocks / std::max(NumBlocks, 1u);
+    NumEntries = std::max<unsigned>(std::min(NumOrderRegs, MemoryBound),
+                                    MinCacheEntries);
+  }
+  NumEntries = std::min<unsigned>(NumEntries, MaxCacheEntries);
+  if (Entries.size() != NumEntries) {
+    assert(none_of(Entries, [](const Entry &E) { return E.hasRefs(); }) &&
+           "Cannot resize cache with references");
+    Entries.clear();
+    Entries.resize(NumEntries);
+    Clock = 0;
+  }
+  for (Entry &E : Entries) {
     E.clear(mf, indexes, lis);
+    E.shrinkBlocks(NumBlocks);
+  }
 }
 
 InterferenceCache::Entry *InterferenceCache::get(MCRegister PhysReg) {
-  unsigned char E = PhysRegEntries[PhysReg.id()];
-  if (E < CacheEntries && Entries[E].getPhysReg() == PhysReg) {
-    if (!Entries[E].valid(LIUArray, TRI))
+  unsigned E = PhysRegEntries[PhysReg.id()];
+  if (E < Entries.size() && Entries[E].getPhysReg() == PhysReg) {
+    ++NumCacheHits;
+    if (!Entries[E].valid(LIUArray, TRI)) {
+      ++NumCacheRevalidations;
       Entries[E].revalidate(LIUArray, TRI);
+    }
+    Entries[E].setReferenced(true);
     return &Entries[E];
   }
-  // No valid entry exists, pick the next round-robin entry.
-  E = RoundRobin;
-  if (++RoundRobin == CacheEntries)
-    RoundRobin = 0;
-  for (unsigned i = 0; i != CacheEntries; ++i) {
+  // No valid entry exists. The first pass of the clock may only clear the
+  // referenced bits, the second one finds an entry unless all are in use.
+  ++NumCacheMisses;
+  unsigned NumEntries = Entries.size();
+  for (unsigned i = 0; i != 2 * NumEntries; ++i) {
+    E = Clock;
+    if (++Clock == NumEntries)
+      Clock = 0;
     // Skip entries that are in use.
-    if (Entries[E].hasRefs()) {
-      if (++E == CacheEntries)
-        E = 0;
+    if (Entries[E].hasRefs())
+      continue;
+    if (Entries[E].isReferenced()) {
+      Entries[E].setReferenced(false);
       continue;
     }
     Entries[E].reset(PhysReg, LIUArray, TRI, MF);
+    Entries[E].setReferenced(true);
     PhysRegEntries[PhysReg.id()] = E;
     return &Entries[E];
   }
@@ -110,6 +155,7 @@ void InterferenceCache::Entry::reset(MCRegister physReg,
   PrevPos = SlotIndex();
   RegUnits.clear();
   for (MCRegUnit Unit : TRI->regunits(PhysReg)) {
+    Flat = LIUArray[Unit].isFlat();
     RegUnits.push_back(LIUArray[Unit]);
     RegUnits.back().Fixed = &LIS->getRegUnit(Unit);
   }
@@ -129,6 +175,16 @@ bool InterferenceCache::Entry::valid(LiveIntervalUnion *LIUArray,
 }
 
 void InterferenceCache::Entry::update(unsigned MBBNum) {
+  // All the unions have the same storage, so the iterator type is chosen once
+  // per update rather than on every step.
+  if (Flat)
+    updateImpl<true>(MBBNum);
+  else
+    updateImpl<false>(MBBNum);
+}
+
+template <bool IsFlat>
+void InterferenceCache::Entry::updateImpl(unsigned MBBNum) {
   SlotIndex Start, Stop;
   std::tie(Start, Stop) = Indexes->getMBBRange(MBBNum);
 
@@ -136,12 +192,12 @@ void InterferenceCache::Entry::update(unsigned MBBNum) {
   if (PrevPos != Start) {
     if (!PrevPos.isValid() || Start < PrevPos) {
       for (RegUnitInfo &RUI : RegUnits) {
-        RUI.VirtI.find(Start);
+        RUI.getVirtI<IsFlat>().find(Start);
         RUI.FixedI = RUI.Fixed->find(Start);
       }
     } else {
       for (RegUnitInfo &RUI : RegUnits) {
-        RUI.VirtI.advanceTo(Start);
+        RUI.getVirtI<IsFlat>().advanceTo(Start);
         if (RUI.FixedI != RUI.Fixed->end())
           RUI.FixedI = RUI.Fixed->advanceTo(RUI.FixedI, Start);
       }
@@ -155,12 +211,13 @@ void InterferenceCache::Entry::update(unsigned MBBNum) {
   ArrayRef<SlotIndex> RegMaskSlots;
   ArrayRef<const uint32_t*> RegMaskBits;
   while (true) {
+    ++NumBlockUpdates;
     BI->Tag = Tag;
     BI->First = BI->Last = SlotIndex();
 
     // Check for first interference from virtregs.
     for (RegUnitInfo &RUI : RegUnits) {
-      LiveIntervalUnion::SegmentIter &I = RUI.VirtI;
+      auto &I = RUI.getVirtI<IsFlat>();
       if (!I.valid())
         continue;
       SlotIndex StartI = I.start();
@@ -211,7 +268,7 @@ void InterferenceCache::Entry::update(unsigned MBBNum) {
 
   // Check for last interference in block.
   for (RegUnitInfo &RUI : RegUnits) {
-    LiveIntervalUnion::SegmentIter &I = RUI.VirtI;
+    auto &I = RUI.getVirtI<IsFlat>();
     if (!I.valid() || I.start() >= Stop)
       continue;
     I.advanceTo(Stop);
@@ -22,6 +22,7 @@
 #include <cassert>
 #include <cstddef>
 #include <cstdlib>
+#include <vector>
 
 namespace llvm {
 
@@ -53,6 +54,10 @@ class LLVM_LIBRARY_VISIBILITY InterferenceCache {
     /// RefCount - The total number of Cursor instances referring to this Entry.
     unsigned RefCount = 0;
 
+    /// Referenced - Set when the entry is used, and cleared when the
+    /// replacement clock passes over it.
+    bool Referenced = false;
+
     /// MF - The current function.
     MachineFunction *MF = nullptr;
 
@@ -73,6 +78,9 @@ class LLVM_LIBRARY_VISIBILITY InterferenceCache {
       /// register interference.
       LiveIntervalUnion::SegmentIter VirtI;
 
+      /// The same for a LiveIntervalUnion with flat storage.
+      LiveIntervalUnion::FlatSegmentIter FlatVirtI;
+
       /// Tag of the LIU last time we looked.
       unsigned VirtTag;
 
@@ -83,7 +91,18 @@ class LLVM_LIBRARY_VISIBILITY InterferenceCache {
       LiveInterval::iterator FixedI;
 
       RegUnitInfo(LiveIntervalUnion &LIU) : VirtTag(LIU.getTag()) {
-        VirtI.setMap(LIU.getMap());
+        if (LIU.isFlat())
+          FlatVirtI.setUnion(LIU);
+        else
+          VirtI.setMap(LIU.getMap());
+      }
+
+      /// Return the iterator that is in use.
+      template <bool IsFlat> auto &getVirtI() {
+        if constexpr (IsFlat)
+          return FlatVirtI;
+        else
+          return VirtI;
       }
     };
 
@@ -92,10 +111,14 @@ class LLVM_LIBRARY_VISIBILITY InterferenceCache {
     SmallVector<RegUnitInfo, 4> RegUnits;
 
     /// Blocks - Interference for each block in the function.
-    SmallVector<BlockInterference, 8> Blocks;
+    std::vector<BlockInterference> Blocks;
+
+    /// Flat - The LiveIntervalUnions of PhysReg use flat storage.
+    bool Flat = false;
 
     /// update - Recompute Blocks[MBBNum]
     void update(unsigned MBBNum);
+    template <bool IsFlat> void updateImpl(unsigned MBBNum);
 
   public:
     Entry() = default;
@@ -103,17 +126,28 @@ class LLVM_LIBRARY_VISIBILITY InterferenceCache {
     void clear(MachineFunction *mf, SlotIndexes *indexes, LiveIntervals *lis) {
       assert(!hasRefs() && "Cannot clear cache entry with references");
       PhysReg = MCRegister::NoRegister;
+      Referenced = false;
       MF = mf;
       Indexes = indexes;
       LIS = lis;
     }
 
+    /// Free the block array if it is much larger than \p NumBlocks needs,
+    /// so a large function doesn't keep its memory after it is allocated.
+    void shrinkBlocks(unsigned NumBlocks) {
+      if (Blocks.capacity() > 2 * size_t(NumBlocks))
+        std::vector<BlockInterference>().swap(Blocks);
+    }
+
     MCRegister getPhysReg() const { return PhysReg; }
 
     void addRef(int Delta) { RefCount += Delta; }
 
     bool hasRefs() const { return RefCount > 0; }
 
+    bool isReferenced() const { return Referenced; }
+    void setReferenced(bool R) { Referenced = R; }
+
     void revalidate(LiveIntervalUnion *LIUArray, const TargetRegisterInfo *TRI);
 
     /// valid - Return true if this is a valid entry for physReg.
@@ -132,9 +166,20 @@ class LLVM_LIBRARY_VISIBILITY InterferenceCache {
   };
 
   // We don't keep a cache entry for every physical register, that would use too
-  // much memory. Instead, a fixed number of cache entries are used in a round-
-  // robin manner.
-  enum { CacheEntries = 32 };
+  // much memory. Instead, there is one entry for each register in the largest
+  // allocation order, within these bounds. Entries are replaced with the clock
+  // algorithm, which gives recently used entries a second chance.
+  //
+  // Each entry holds a BlockInterference (24 bytes) per block, so the entries
+  // beyond MinCacheEntries are only added while all entries together hold at
+  // most MaxCacheBlocks of them, about 6 MiB. A function with many blocks gets
+  // MinCacheEntries, which uses as much memory as the cache did before it was
+  // sized by the allocation order.
+  enum {
+    MinCacheEntries = 32,
+    MaxCacheEntries = 255,
+    MaxCacheBlocks = 1 << 18
+  };
 
   const TargetRegisterInfo *TRI = nullptr;
   LiveIntervalUnion *LIUArray = nullptr;
@@ -145,11 +190,11 @@ class LLVM_LIBRARY_VISIBILITY InterferenceCache {
   unsigned char* PhysRegEntries = nullptr;
   size_t PhysRegEntriesCount = 0;
 
-  // Next round-robin entry to be picked.
-  unsigned RoundRobin = 0;
+  // Next entry the replacement clock looks at.
+  unsigned Clock = 0;
 
   // The actual cache entries.
-  Entry Entries[CacheEntries];
+  SmallVector<Entry, 0> Entries;
 
   // get - Get a valid entry for PhysReg.
   Entry *get(MCRegister PhysReg);
@@ -164,14 +209,15 @@ public:
 
   void reinitPhysRegEntries();
 
-  /// init - Prepare cache for a new function.
+  /// init - Prepare cache for a new function, where the longest allocation
+  /// order has NumOrderRegs registers.
   void init(MachineFunction *mf, LiveIntervalUnion *liuarray,
             SlotIndexes *indexes, LiveIntervals *lis,
-            const TargetRegisterInfo *tri);
+            const TargetRegisterInfo *tri, unsigned NumOrderRegs);
 
   /// getMaxCursors - Return the maximum number of concurrent cursors that can
   /// be supported.
-  unsigned getMaxCursors() const { return CacheEntries; }
+  unsigned getMaxCursors() const { return Entries.size(); }
 
   /// Cursor - The primary query interface for the block interference cache.
   class Cursor {
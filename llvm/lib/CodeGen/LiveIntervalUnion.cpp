@@ -16,14 +16,41 @@
 #include "llvm/ADT/STLExtras.h"
 #include "llvm/CodeGen/LiveInterval.h"
 #include "llvm/CodeGen/TargetRegisterInfo.h"
+#include "llvm/Support/CommandLine.h"
 #include "llvm/Support/raw_ostream.h"
+#include <algorithm>
 #include <cassert>
 #include <cstdlib>
+#include <type_traits>
 
 using namespace llvm;
 
 #define DEBUG_TYPE "regalloc"
 
+static cl::opt<bool> FlatLiveIntervalUnions(
+    "flat-live-interval-unions", cl::Hidden, cl::init(false),
+    cl::desc("Store the segments of live interval unions in sorted arrays "
+             "instead of B+-trees"));
+
+LiveIntervalUnion::LiveIntervalUnion(Allocator &a)
+    : UseFlat(FlatLiveIntervalUnions), Segments(a) {}
+
+void LiveIntervalUnion::FlatSegmentIter::advanceTo(SlotIndex X) {
+  unsigned Size = Flat->size();
+  // Queries mostly move to a nearby segment, so look at the next few before
+  // searching the rest.
+  for (unsigned End = std::min(I + 8, Size); I < End; ++I)
+    if (X < (*Flat)[I].Stop)
+      return;
+  if (I >= Size)
+    return;
+  I = std::partition_point(Flat->begin() + I, Flat->end(),
+                           [&](const FlatSegment &Seg) {
+                             return Seg.Stop <= X;
+                           }) -
+      Flat->begin();
+}
+
 // Merge a LiveInterval's segments. Guarantee no overlaps.
 void LiveIntervalUnion::unify(const LiveInterval &VirtReg,
                               const LiveRange &Range) {
@@ -31,10 +58,27 @@ void LiveIntervalUnion::unify(const LiveInterval &VirtReg,
     return;
   ++Tag;
 
+  if (UseFlat) {
+    // Append the new segments and merge them with the ones they interleave
+    // with, in a single pass.
+    unsigned First = llvm::partition_point(Flat, [&](const FlatSegment &Seg) {
+                       return Seg.Stop <= Range.beginIndex();
+                     }) -
+                     Flat.begin();
+    unsigned Middle = Flat.size();
+    for (const LiveRange::Segment &Seg : Range)
+      Flat.push_back({Seg.start, Seg.end, &VirtReg});
+    std::inplace_merge(Flat.begin() + First, Flat.begin() + Middle, Flat.end(),
+                       [](const FlatSegment &A, const FlatSegment &B) {
+                         return A.Start < B.Start;
+                       });
+    return;
+  }
+
   // Insert each of the virtual register's live segments into the map.
   LiveRange::const_iterator RegPos = Range.begin();
   LiveRange::const_iterator RegEnd = Range.end();
-  SegmentIter SegPos = Segments.find(RegPos->start);
+  LiveSegments::iterator SegPos = Segments.find(RegPos->start);
 
   while (SegPos.valid()) {
     SegPos.insert(RegPos->start, RegPos->end, &VirtReg);
@@ -59,10 +103,26 @@ void LiveIntervalUnion::extract(const LiveInterval &VirtReg,
     return;
   ++Tag;
 
+  if (UseFlat) {
+    // All the segments of VirtReg are in the span covered by Range.
+    auto First = llvm::partition_point(Flat, [&](const FlatSegment &Seg) {
+      return Seg.Stop <= Range.beginIndex();
+    });
+    auto Last = std::partition_point(First, Flat.end(),
+                                     [&](const FlatSegment &Seg) {
+                                       return Seg.Start < Range.endIndex();
+                                     });
+    auto NewLast = std::remove_if(First, Last, [&](const FlatSegment &Seg) {
+      return Seg.VirtReg == &VirtReg;
+    });
+    Flat.erase(NewLast, Last);
+    return;
+  }
+
   // Remove each of the virtual register's live segments from the map.
   LiveRange::const_iterator RegPos = Range.begin();
   LiveRange::const_iterator RegEnd = Range.end();
-  SegmentIter SegPos = Segments.find(RegPos->start);
+  LiveSegments::iterator SegPos = Segments.find(RegPos->start);
 
   while (true) {
     assert(SegPos.value() == &VirtReg && "Inconsistent LiveInterval");
@@ -85,16 +145,27 @@ LiveIntervalUnion::print(raw_ostream &OS, const TargetRegisterInfo *TRI) const {
     OS << " empty\n";
     return;
   }
-  for (LiveSegments::const_iterator SI = Segments.begin(); SI.valid(); ++SI) {
-    OS << " [" << SI.start() << ' ' << SI.stop()
-       << "):" << printReg(SI.value()->reg(), TRI);
-  }
+  auto PrintSegments = [&](auto SI) {
+    for (; SI.valid(); ++SI) {
+      OS << " [" << SI.start() << ' ' << SI.stop()
+         << "):" << printReg(SI.value()->reg(), TRI);
+    }
+  };
+  if (UseFlat)
+    PrintSegments(flatBegin());
+  else
+    PrintSegments(Segments.begin());
   OS << '\n';
 }
 
 #ifndef NDEBUG
 // Verify the live intervals in this union and add them to the visited set.
 void LiveIntervalUnion::verify(LiveVirtRegBitSet& VisitedVRegs) {
+  if (UseFlat) {
+    for (const FlatSegment &Seg : Flat)
+      VisitedVRegs.set(Seg.VirtReg->reg().id());
+    return;
+  }
   for (SegmentIter SI = Segments.begin(); SI.valid(); ++SI)
     VisitedVRegs.set(SI.value()->reg().id());
 }
@@ -103,6 +174,8 @@ void LiveIntervalUnion::verify(LiveVirtRegBitSet& VisitedVRegs) {
 const LiveInterval *LiveIntervalUnion::getOneVReg() const {
   if (empty())
     return nullptr;
+  if (UseFlat)
+    return Flat.front().VirtReg;
   for (LiveSegments::const_iterator SI = Segments.begin(); SI.valid(); ++SI) {
     // return the first valid live interval
     return SI.value();
@@ -128,6 +201,16 @@ bool LiveIntervalUnion::Query::isSeenInterference(
 //
 unsigned
 LiveIntervalUnion::Query::collectInterferingVRegs(unsigned MaxInterferingRegs) {
+  // Pick the iterator for the union storage once, the scan itself is the same.
+  if (LiveUnion->isFlat())
+    return collectInterferingVRegs(FlatLiveUnionI, MaxInterferingRegs);
+  return collectInterferingVRegs(LiveUnionI, MaxInterferingRegs);
+}
+
+template <typename IterT>
+unsigned
+LiveIntervalUnion::Query::collectInterferingVRegs(IterT &LiveUnionI,
+                                                  unsigned MaxInterferingRegs) {
   // Fast path return if we already have the desired information.
   if (SeenAllInterferences || InterferingVRegs.size() >= MaxInterferingRegs)
     return InterferingVRegs.size();
@@ -144,7 +227,10 @@ LiveIntervalUnion::Query::collectInterferingVRegs(unsigned MaxInterferingRegs) {
 
     // In most cases, the union will start before LR.
     LRI = LR->begin();
-    LiveUnionI.setMap(LiveUnion->getMap());
+    if constexpr (std::is_same_v<IterT, FlatSegmentIter>)
+      LiveUnionI.setUnion(*LiveUnion);
+    else
+      LiveUnionI.setMap(LiveUnion->getMap());
     LiveUnionI.find(LRI->start);
   }
 
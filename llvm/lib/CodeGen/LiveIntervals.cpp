@@ -18,6 +18,7 @@
 #include "llvm/ADT/DepthFirstIterator.h"
 #include "llvm/ADT/SmallPtrSet.h"
 #include "llvm/ADT/SmallVector.h"
+#include "llvm/ADT/Statistic.h"
 #include "llvm/ADT/iterator_range.h"
 #include "llvm/CodeGen/LiveInterval.h"
 #include "llvm/CodeGen/LiveIntervalCalc.h"
@@ -47,6 +48,7 @@
 #include "llvm/Support/Compiler.h"
 #include "llvm/Support/Debug.h"
 #include "llvm/Support/MathExtras.h"
+#include "llvm/Support/Parallel.h"
 #include "llvm/Support/raw_ostream.h"
 #include <algorithm>
 #include <cassert>
@@ -59,6 +61,10 @@ using namespace llvm;
 
 #define DEBUG_TYPE "regalloc"
 
+STATISTIC(NumIntervalsCreated, "Number of live intervals created");
+STATISTIC(NumIntervalsRecycled,
+          "Number of live intervals created in the memory of removed ones");
+
 AnalysisKey LiveIntervalsAnalysis::Key;
 
 LiveIntervalsAnalysis::Result
@@ -106,6 +112,11 @@ cl::opt<bool> llvm::UseSegmentSetForPhysRegs(
     cl::desc(
         "Use segment set for the computation of the live ranges of physregs."));
 
+static cl::opt<unsigned> ParallelLiveIntervals(
+    "parallel-live-intervals", cl::Hidden, cl::init(0),
+    cl::desc("Compute the live intervals of functions with at least this "
+             "many virtual registers in parallel (0 = never)"));
+
 void LiveIntervalsWrapperPass::getAnalysisUsage(AnalysisUsage &AU) const {
   AU.setPreservesCFG();
   AU.addPreserved<LiveVariablesWrapperPass>();
@@ -140,8 +151,12 @@ bool LiveIntervals::invalidate(
 void LiveIntervals::clear() {
   // Free the live intervals themselves.
   for (unsigned i = 0, e = VirtRegIntervals.size(); i != e; ++i)
-    delete VirtRegIntervals[Register::index2VirtReg(i)];
+    if (LiveInterval *LI = VirtRegIntervals[Register::index2VirtReg(i)])
+      LI->~LiveInterval();
   VirtRegIntervals.clear();
+  IntervalRecycler.clear(IntervalAllocator);
+  IntervalAllocator.Reset();
+  NumRecyclable = 0;
   RegMaskSlots.clear();
   RegMaskBits.clear();
   RegMaskBlocks.clear();
@@ -152,6 +167,7 @@ void LiveIntervals::clear() {
 
   // Release VNInfo memory regions, VNInfo objects don't need to be dtor'd.
   VNInfoAllocator.Reset();
+  TaskVNInfoAllocators.clear();
 }
 
 void LiveIntervals::analyze(MachineFunction &fn) {
@@ -218,7 +234,13 @@ LLVM_DUMP_METHOD void LiveIntervals::dump() const { print(dbgs()); }
 
 LiveInterval *LiveIntervals::createInterval(Register reg) {
   float Weight = reg.isPhysical() ? huge_valf : 0.0F;
-  return new LiveInterval(reg, Weight);
+  ++NumIntervalsCreated;
+  if (NumRecyclable) {
+    --NumRecyclable;
+    ++NumIntervalsRecycled;
+  }
+  return new (IntervalRecycler.Allocate(IntervalAllocator))
+      LiveInterval(reg, Weight);
 }
 
 /// Compute the live interval of a virtual register, based on defs and uses.
@@ -231,6 +253,13 @@ bool LiveIntervals::computeVirtRegInterval(LiveInterval &LI) {
 }
 
 void LiveIntervals::computeVirtRegs() {
+  if (ParallelLiveIntervals &&
+      MRI->getNumVirtRegs() >= ParallelLiveIntervals &&
+      parallel::strategy.compute_thread_count() > 1) {
+    computeVirtRegsInParallel();
+    return;
+  }
+
   for (unsigned i = 0, e = MRI->getNumVirtRegs(); i != e; ++i) {
     Register Reg = Register::index2VirtReg(i);
     if (MRI->reg_nodbg_empty(Reg))
@@ -244,6 +273,50 @@ void LiveIntervals::computeVirtRegs() {
   }
 }
 
+void LiveIntervals::computeVirtRegsInParallel() {
+  SmallVector<LiveInterval *, 0> Intervals;
+  for (unsigned i = 0, e = MRI->getNumVirtRegs(); i != e; ++i) {
+    Register Reg = Register::index2VirtReg(i);
+    if (!MRI->reg_nodbg_empty(Reg))
+      Intervals.push_back(&createEmptyInterval(Reg));
+  }
+  if (Intervals.empty())
+    return;
+
+  // Computing an interval only reads the CFG, the dominator tree, and the
+  // operands of its own register, except for clearing their kill flags. The
+  // dominator tree updates its DFS numbers lazily, so do that up front.
+  DomTree->updateDFSNumbers();
+
+  // Each task computes a contiguous run of intervals with its own calculator
+  // and allocator. A few tasks per thread balance the load.
+  size_t NumTasks = std::min<size_t>(
+      Intervals.size(), 4 * parallel::strategy.compute_thread_count());
+  size_t FirstAlloc = TaskVNInfoAllocators.size();
+  for (size_t Task = 0; Task != NumTasks; ++Task)
+    TaskVNInfoAllocators.push_back(std::make_unique<VNInfo::Allocator>());
+  parallelFor(0, NumTasks, [&](size_t Task) {
+    LiveIntervalCalc Calc;
+    VNInfo::Allocator *Alloc = TaskVNInfoAllocators[FirstAlloc + Task].get();
+    size_t Begin = Intervals.size() * Task / NumTasks;
+    size_t End = Intervals.size() * (Task + 1) / NumTasks;
+    for (LiveInterval *LI : ArrayRef(Intervals).slice(Begin, End - Begin)) {
+      Calc.reset(MF, Indexes, DomTree, Alloc);
+      Calc.calculate(*LI, MRI->shouldTrackSubRegLiveness(LI->reg()));
+    }
+  });
+
+  // Marking dead defs and splitting write to instructions that are shared
+  // between registers, so they happen in register order afterwards. This
+  // gives the same result as computing the intervals one at a time.
+  for (LiveInterval *LI : Intervals) {
+    if (computeDeadValues(*LI, nullptr)) {
+      SmallVector<LiveInterval *, 8> SplitLIs;
+      splitSeparateComponents(*LI, SplitLIs);
+    }
+  }
+}
+
 void LiveIntervals::computeRegMasks() {
   RegMaskBlocks.resize(MF->getNumBlockIDs());
 
@@ -948,6 +1021,33 @@ static bool hasLiveThroughUse(const MachineInstr *MI, Register Reg) {
   return false;
 }
 
+// Count the register mask slots inside the segments of LR, stopping once
+// Limit slots are found. RegMaskSlots is sorted, so every segment takes two
+// binary searches over the slots that follow the previous segment.
+static unsigned countSlotsInSegments(ArrayRef<SlotIndex> Slots,
+                                     const LiveRange &LR, unsigned Limit) {
+  unsigned Num = 0;
+  for (const LiveRange::Segment &S : LR) {
+    Slots = Slots.drop_front(llvm::lower_bound(Slots, S.start) - Slots.begin());
+    if (Slots.empty())
+      break;
+    auto End = llvm::lower_bound(Slots, S.end);
+    Num += End - Slots.begin();
+    if (Num >= Limit)
+      break;
+    Slots = Slots.drop_front(End - Slots.begin());
+  }
+  return Num;
+}
+
+unsigned LiveIntervals::getNumCallsCrossed(const LiveRange &LR) const {
+  return countSlotsInSegments(RegMaskSlots, LR, ~0u);
+}
+
+bool LiveIntervals::crossesCall(const LiveRange &LR) const {
+  return countSlotsInSegments(RegMaskSlots, LR, 1) != 0;
+}
+
 bool LiveIntervals::checkRegMaskInterference(const LiveInterval &LI,
                                              BitVector &UsableRegs) {
   if (LI.empty())
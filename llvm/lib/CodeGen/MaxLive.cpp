@@ -0,0 +1,201 @@
+//===- MaxLive.cpp - Maximal register pressure ----------------------------===//
+//
+// Part of the LLVM Project, under the Apache License v2.0 with LLVM Exceptions.
+// See https://llvm.org/LICENSE.txt for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+//
+//===----------------------------------------------------------------------===//
+//
+// The segments of all live intervals are cut at block boundaries. Each block
+// is then swept in order of segment start, keeping the end indexes of the live
+// segments of each register class in a min-heap, so the heap size is the
+// number of live registers at the current point.
+//
+//===----------------------------------------------------------------------===//
+
+#include "llvm/CodeGen/MaxLive.h"
+#include "llvm/ADT/DepthFirstIterator.h"
+#include "llvm/ADT/STLExtras.h"
+#include "llvm/CodeGen/LiveIntervals.h"
+#include "llvm/CodeGen/MachineDominators.h"
+#include "llvm/CodeGen/MachineRegisterInfo.h"
+#include "llvm/CodeGen/SlotIndexes.h"
+#include "llvm/CodeGen/TargetRegisterInfo.h"
+#include "llvm/CodeGen/TargetSubtargetInfo.h"
+#include "llvm/InitializePasses.h"
+#include "llvm/Support/raw_ostream.h"
+#include <algorithm>
+#include <functional>
+
+using namespace llvm;
+
+#define DEBUG_TYPE "max-live"
+
+namespace {
+/// The part of a live segment that lies in one block.
+struct Piece {
+  SlotIndex Start;
+  SlotIndex End;
+  unsigned ClassID;
+};
+} // end anonymous namespace
+
+void MaxLive::compute(const MachineFunction &MF, const LiveIntervals &LIS,
+                      const MachineDominatorTree &MDT) {
+  releaseMemory();
+  this->MF = &MF;
+  TRI = MF.getSubtarget().getRegisterInfo();
+  const MachineRegisterInfo &MRI = MF.getRegInfo();
+  const SlotIndexes &Indexes = *LIS.getSlotIndexes();
+  unsigned NumClasses = TRI->getNumRegClasses();
+
+  FunctionMaxLive.assign(NumClasses, 0);
+  BlockMaxLive.resize(MF.getNumBlockIDs());
+
+  SmallVector<SmallVector<Piece, 8>, 0> Pieces(MF.getNumBlockIDs());
+  for (unsigned I = 0, E = MRI.getNumVirtRegs(); I != E; ++I) {
+    Register Reg = Register::index2VirtReg(I);
+    if (MRI.reg_nodbg_empty(Reg) || !LIS.hasInterval(Reg))
+      continue;
+    unsigned ClassID = MRI.getRegClass(Reg)->getID();
+    for (const LiveRange::Segment &S : LIS.getInterval(Reg)) {
+      SlotIndex Start = S.start;
+      MachineFunction::const_iterator MBBI =
+          Indexes.getMBBFromIndex(Start)->getIterator();
+      while (true) {
+        SlotIndex BlockEnd = Indexes.getMBBEndIdx(&*MBBI);
+        Pieces[MBBI->getNumber()].push_back(
+            {Start, std::min(S.end, BlockEnd), ClassID});
+        if (S.end <= BlockEnd)
+          break;
+        ++MBBI;
+        Start = Indexes.getMBBStartIdx(&*MBBI);
+      }
+    }
+  }
+
+  // Live segments by class, as min-heaps on the end index.
+  SmallVector<SmallVector<SlotIndex, 8>, 32> Ends(NumClasses);
+  SmallVector<unsigned, 32> Max(NumClasses);
+  SmallVector<unsigned, 8> Touched;
+  for (const MachineDomTreeNode *Node : depth_first(MDT.getRootNode())) {
+    unsigned Num = Node->getBlock()->getNumber();
+    SmallVectorImpl<Piece> &BlockPieces = Pieces[Num];
+    llvm::sort(BlockPieces, [](const Piece &A, const Piece &B) {
+      return A.Start < B.Start;
+    });
+    for (const Piece &P : BlockPieces) {
+      SmallVectorImpl<SlotIndex> &Heap = Ends[P.ClassID];
+      if (!Max[P.ClassID])
+        Touched.push_back(P.ClassID);
+      while (!Heap.empty() && Heap.front() <= P.Start) {
+        std::pop_heap(Heap.begin(), Heap.end(), std::greater<SlotIndex>());
+        Heap.pop_back();
+      }
+      Heap.push_back(P.End);
+      std::push_heap(Heap.begin(), Heap.end(), std::greater<SlotIndex>());
+      Max[P.ClassID] = std::max<unsigned>(Max[P.ClassID], Heap.size());
+    }
+
+    llvm::sort(Touched);
+    for (unsigned ClassID : Touched) {
+      BlockMaxLive[Num].push_back({ClassID, Max[ClassID]});
+      FunctionMaxLive[ClassID] =
+          std::max(FunctionMaxLive[ClassID], Max[ClassID]);
+      Max[ClassID] = 0;
+      Ends[ClassID].clear();
+    }
+    Touched.clear();
+    BlockPieces.clear();
+  }
+}
+
+unsigned MaxLive::getMaxLive(const TargetRegisterClass &RC) const {
+  return RC.getID() < FunctionMaxLive.size() ? FunctionMaxLive[RC.getID()] : 0;
+}
+
+unsigned MaxLive::getMaxLive(const MachineBasicBlock &MBB,
+                             const TargetRegisterClass &RC) const {
+  unsigned Num = MBB.getNumber();
+  if (Num >= BlockMaxLive.size())
+    return 0;
+  const auto &Entries = BlockMaxLive[Num];
+  auto It = llvm::partition_point(
+      Entries, [&](const auto &Entry) { return Entry.first < RC.getID(); });
+  return It != Entries.end() && It->first == RC.getID() ? It->second : 0;
+}
+
+void MaxLive::releaseMemory() {
+  MF = nullptr;
+  TRI = nullptr;
+  FunctionMaxLive.clear();
+  BlockMaxLive.clear();
+}
+
+void MaxLive::print(raw_ostream &OS) const {
+  if (!MF)
+    return;
+  OS << "MaxLive for machine function: " << MF->getName() << '\n';
+  for (unsigned ClassID = 0, E = FunctionMaxLive.size(); ClassID != E;
+       ++ClassID)
+    if (FunctionMaxLive[ClassID])
+      OS << "  " << TRI->getRegClassName(TRI->getRegClass(ClassID)) << ": "
+         << FunctionMaxLive[ClassID] << '\n';
+  for (const MachineBasicBlock &MBB : *MF) {
+    const auto &Entries = BlockMaxLive[MBB.getNumber()];
+    if (Entries.empty())
+      continue;
+    OS << "  " << printMBBReference(MBB) << ':';
+    for (auto [ClassID, Max] : Entries)
+      OS << ' ' << TRI->getRegClassName(TRI->getRegClass(ClassID)) << '='
+         << Max;
+    OS << '\n';
+  }
+}
+
+char MaxLiveWrapperPass::ID = 0;
+
+INITIALIZE_PASS_BEGIN(MaxLiveWrapperPass, DEBUG_TYPE,
+                      "Maximal Register Pressure Analysis", false, true)
+INITIALIZE_PASS_DEPENDENCY(LiveIntervalsWrapperPass)
+INITIALIZE_PASS_DEPENDENCY(MachineDominatorTreeWrapperPass)
+INITIALIZE_PASS_END(MaxLiveWrapperPass, DEBUG_TYPE,
+                    "Maximal Register Pressure Analysis", false, true)
+
+MaxLiveWrapperPass::MaxLiveWrapperPass() : MachineFunctionPass(ID) {
+  initializeMaxLiveWrapperPassPass(*PassRegistry::getPassRegistry());
+}
+
+void MaxLiveWrapperPass::getAnalysisUsage(AnalysisUsage &AU) const {
+  AU.setPreservesAll();
+  AU.addRequired<LiveIntervalsWrapperPass>();
+  AU.addRequired<MachineDominatorTreeWrapperPass>();
+  MachineFunctionPass::getAnalysisUsage(AU);
+}
+
+bool MaxLiveWrapperPass::runOnMachineFunction(MachineFunction &MF) {
+  ML.compute(MF, getAnalysis<LiveIntervalsWrapperPass>().getLIS(),
+             getAnalysis<MachineDominatorTreeWrapperPass>().getDomTree());
+  return false;
+}
+
+void MaxLiveWrapperPass::print(raw_ostream &OS, const Module *) const {
+  ML.print(OS);
+}
+
+AnalysisKey MaxLiveAnalysis::Key;
+
+MaxLive MaxLiveAnalysis::run(MachineFunction &MF,
+                             MachineFunctionAnalysisManager &MFAM) {
+  MaxLive ML;
+  ML.compute(MF, MFAM.getResult<LiveIntervalsAnalysis>(MF),
+             MFAM.getResult<MachineDominatorTreeAnalysis>(MF));
+  return ML;
+}
+
+PreservedAnalyses
+MaxLivePrinterPass::run(MachineFunction &MF,
+                        MachineFunctionAnalysisManager &MFAM) {
+  MFAM.getResult<MaxLiveAnalysis>(MF).print(OS);
+  return PreservedAnalyses::all();
+}
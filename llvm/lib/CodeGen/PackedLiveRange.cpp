@@ -0,0 +1,68 @@
+//===- PackedLiveRange.cpp - Live range search copy -----------------------===//
+//
+// Part of the LLVM Project, under the Apache License v2.0 with LLVM Exceptions.
+// See https://llvm.org/LICENSE.txt for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+//
+//===----------------------------------------------------------------------===//
+
+#include "llvm/CodeGen/PackedLiveRange.h"
+#include "llvm/CodeGen/LiveInterval.h"
+
+using namespace llvm;
+
+/// The number of segments counted by a linear scan at the end of a search. A
+/// few vector registers worth of 32-bit ends.
+static constexpr unsigned ScanSize = 16;
+
+void PackedLiveRange::assign(const LiveRange &LR) {
+  Starts.clear();
+  Ends.clear();
+  Starts.reserve(LR.size());
+  Ends.reserve(LR.size());
+  for (const LiveRange::Segment &S : LR) {
+    Starts.push_back(S.start.getIndex());
+    Ends.push_back(S.end.getIndex());
+  }
+}
+
+unsigned PackedLiveRange::findRaw(uint32_t Idx) const {
+  // Every end before Base is at most Idx, and every end from Base + N on is
+  // larger. The select doesn't depend on a branch prediction.
+  const uint32_t *Base = Ends.data();
+  size_t N = Ends.size();
+  while (N > ScanSize) {
+    size_t Half = N / 2;
+    Base = Base[Half] <= Idx ? Base + Half : Base;
+    N -= Half;
+  }
+  unsigned Count = 0;
+  for (size_t I = 0; I != N; ++I)
+    Count += Base[I] <= Idx;
+  return (Base - Ends.data()) + Count;
+}
+
+bool PackedLiveRange::overlaps(SlotIndex Start, SlotIndex End) const {
+  assert(Start < End && "Invalid range");
+  unsigned I = find(Start);
+  return I != size() && Starts[I] < End.getIndex();
+}
+
+bool PackedLiveRange::overlaps(const PackedLiveRange &Other) const {
+  if (empty() || Other.empty())
+    return false;
+  // Skip the segments of each range that end before the other one starts.
+  unsigned I = findRaw(Other.Starts.front());
+  if (I == size())
+    return false;
+  unsigned J = Other.findRaw(Starts[I]);
+  while (I != size() && J != Other.size()) {
+    if (Starts[I] < Other.Ends[J] && Other.Starts[J] < Ends[I])
+      return true;
+    if (Ends[I] < Other.Ends[J])
+      ++I;
+    else
+      ++J;
+  }
+  return false;
+}
@@ -0,0 +1,149 @@
+//===- ParallelCopy.cpp - Parallel copy lowering --------------------------===//
+//
+// Part of the LLVM Project, under the Apache License v2.0 with LLVM Exceptions.
+// See https://llvm.org/LICENSE.txt for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+//
+//===----------------------------------------------------------------------===//
+
+#include "llvm/CodeGen/ParallelCopy.h"
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/Statistic.h"
+#include "llvm/CodeGen/MachineBlockFrequencyInfo.h"
+#include "llvm/CodeGen/MachineFunction.h"
+#include "llvm/CodeGen/TargetInstrInfo.h"
+#include "llvm/CodeGen/TargetSubtargetInfo.h"
+#include "llvm/IR/DebugLoc.h"
+#include "llvm/Support/BlockFrequency.h"
+
+using namespace llvm;
+
+#define DEBUG_TYPE "parallel-copy"
+
+STATISTIC(NumCopies, "Number of copies emitted for parallel copies");
+STATISTIC(NumSwaps, "Number of swaps emitted for parallel copies");
+STATISTIC(NumScratchCycles,
+          "Number of parallel copy cycles broken with a scratch register");
+
+std::optional<SmallVector<ParallelCopyStep, 8>>
+llvm::sequentializeParallelCopy(
+    ArrayRef<std::pair<unsigned, unsigned>> Copies,
+    function_ref<unsigned(unsigned, unsigned)> SwapCost, unsigned Scratch) {
+  SmallVector<std::pair<unsigned, unsigned>, 8> Pending;
+  DenseMap<unsigned, unsigned> NumReaders;
+  DenseMap<unsigned, unsigned> CopyOf;
+  for (auto [Dst, Src] : Copies) {
+    assert(Dst && Src && "Invalid register in parallel copy");
+    assert(Dst != Scratch && Src != Scratch && "Scratch register is not free");
+    if (Dst == Src)
+      continue;
+    bool Inserted = CopyOf.try_emplace(Dst, Pending.size()).second;
+    (void)Inserted;
+    assert(Inserted && "Register is written twice by a parallel copy");
+    Pending.push_back({Dst, Src});
+    ++NumReaders[Src];
+  }
+
+  SmallVector<ParallelCopyStep, 8> Steps;
+  SmallVector<bool, 8> Done(Pending.size());
+
+  // A destination that no other copy reads can be written right away. That
+  // may release its source in turn.
+  SmallVector<unsigned, 8> Ready;
+  for (unsigned I = 0, E = Pending.size(); I != E; ++I)
+    if (!NumReaders.lookup(Pending[I].first))
+      Ready.push_back(I);
+  while (!Ready.empty()) {
+    unsigned I = Ready.pop_back_val();
+    auto [Dst, Src] = Pending[I];
+    Steps.push_back({ParallelCopyStep::Copy, Dst, Src});
+    Done[I] = true;
+    if (--NumReaders[Src])
+      continue;
+    auto It = CopyOf.find(Src);
+    if (It != CopyOf.end() && !Done[It->second])
+      Ready.push_back(It->second);
+  }
+
+  // Every remaining register is read exactly once, so the remaining copies
+  // form disjoint cycles Regs[0] <- Regs[1] <- ... <- Regs[N-1] <- Regs[0].
+  for (unsigned I = 0, E = Pending.size(); I != E; ++I) {
+    if (Done[I])
+      continue;
+    SmallVector<unsigned, 8> Regs;
+    for (unsigned J = I; !Done[J]; J = CopyOf.lookup(Pending[J].second)) {
+      Regs.push_back(Pending[J].first);
+      Done[J] = true;
+    }
+    unsigned N = Regs.size();
+
+    unsigned SwapTotal = 0;
+    for (unsigned J = 0; J + 1 != N; ++J) {
+      unsigned Cost = SwapCost(Regs[J], Regs[J + 1]);
+      if (!Cost) {
+        SwapTotal = 0;
+        break;
+      }
+      SwapTotal += Cost;
+    }
+    unsigned ScratchTotal = Scratch ? N + 1 : 0;
+
+    if (!SwapTotal && !ScratchTotal)
+      return std::nullopt;
+    if (SwapTotal && (!ScratchTotal || SwapTotal < ScratchTotal)) {
+      // Each swap puts one value in place and carries the value of Regs[0]
+      // one position further along the cycle.
+      for (unsigned J = 0; J + 1 != N; ++J)
+        Steps.push_back({ParallelCopyStep::Swap, Regs[J], Regs[J + 1]});
+      continue;
+    }
+    Steps.push_back({ParallelCopyStep::Copy, Scratch, Regs[0]});
+    for (unsigned J = 0; J + 1 != N; ++J)
+      Steps.push_back({ParallelCopyStep::Copy, Regs[J], Regs[J + 1]});
+    Steps.push_back({ParallelCopyStep::Copy, Regs[N - 1], Scratch});
+  }
+  return Steps;
+}
+
+bool llvm::emitParallelCopy(MachineBasicBlock &MBB,
+                            MachineBasicBlock::iterator I, const DebugLoc &DL,
+                            ArrayRef<std::pair<MCRegister, MCRegister>> Copies,
+                            MCRegister Scratch) {
+  const TargetInstrInfo &TII = *MBB.getParent()->getSubtarget().getInstrInfo();
+  SmallVector<std::pair<unsigned, unsigned>, 8> RegCopies;
+  for (auto [Dst, Src] : Copies)
+    RegCopies.push_back({Dst.id(), Src.id()});
+
+  auto Steps = sequentializeParallelCopy(
+      RegCopies,
+      [&](unsigned RegA, unsigned RegB) {
+        return TII.getSwapPhysRegsCost(MCRegister(RegA), MCRegister(RegB));
+      },
+      Scratch.id());
+  if (!Steps)
+    return false;
+
+  for (const ParallelCopyStep &Step : *Steps) {
+    MCRegister Dst(Step.Dst), Src(Step.Src);
+    if (Step.Kind == ParallelCopyStep::Swap) {
+      TII.swapPhysRegs(MBB, I, DL, Dst, Src);
+      ++NumSwaps;
+      continue;
+    }
+    if (Dst == Scratch)
+      ++NumScratchCycles;
+    TII.copyPhysReg(MBB, I, DL, Dst, Src, /*KillSrc=*/Src == Scratch);
+    ++NumCopies;
+  }
+  return true;
+}
+
+bool llvm::isParallelCopyCheaperAtEntry(
+    const MachineBasicBlock &MBB, ArrayRef<const MachineBasicBlock *> Preds,
+    const MachineBlockFrequencyInfo &MBFI) {
+  BlockFrequency PredFreq;
+  for (const MachineBasicBlock *Pred : Preds)
+    PredFreq += MBFI.getBlockFreq(Pred);
+  // On a tie, a single copy is smaller.
+  return MBFI.getBlockFreq(&MBB) <= PredFreq;
+}
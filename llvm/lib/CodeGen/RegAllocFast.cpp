@@ -58,6 +58,12 @@ STATISTIC(NumCoalesced, "Number of copies coalesced");
 static cl::opt<bool> IgnoreMissingDefs("rafast-ignore-missing-defs",
                                        cl::Hidden);
 
+static cl::opt<bool> BeladyEviction(
+    "rafast-belady",
+    cl::desc("Scan each block before allocating it and evict the register "
+             "whose value is referenced furthest away"),
+    cl::init(false), cl::Hidden);
+
 static RegisterRegAlloc fastRegAlloc("fast", "fast register allocator",
                                      createFastRegisterAllocator);
 
@@ -228,6 +234,14 @@ private:
   /// that it is alive across blocks.
   BitVector MayLiveAcrossBlocks;
 
+  /// With -rafast-belady, the positions of the instructions in the current
+  /// block that reference each virtual register, in ascending order. The
+  /// instructions are numbered before any spill or reload is inserted.
+  DenseMap<Register, SmallVector<unsigned, 4>> BlockRefs;
+
+  /// The position of the instruction being allocated in BlockRefs numbering.
+  unsigned CurPos = 0;
+
   /// State of a register unit.
   enum RegUnitState {
     /// A free register is not currently in use and can be allocated
@@ -346,6 +360,9 @@ private:
   void freePhysReg(MCRegister PhysReg);
 
   unsigned calcSpillCost(MCPhysReg PhysReg) const;
+  unsigned calcReuseDistance(MCPhysReg PhysReg) const;
+  void scanFunction(const MachineFunction &MF);
+  void scanBasicBlock(const MachineBasicBlock &MBB);
 
   LiveRegMap::iterator findLiveVirtReg(Register VirtReg) {
     return LiveVirtRegs.find(VirtReg.virtRegIndex());
@@ -519,6 +536,10 @@ bool RegAllocFastImpl::mayLiveOut(Register VirtReg) {
     return !MBB->succ_empty();
   }
 
+  // scanFunction() marked every register referenced in more than one block.
+  if (BeladyEviction && !MBB->isSuccessor(MBB))
+    return false;
+
   const MachineInstr *SelfLoopDef = nullptr;
 
   // If this block loops back to itself, it is necessary to check whether the
@@ -570,6 +591,9 @@ bool RegAllocFastImpl::mayLiveIn(Register VirtReg) {
   if (MayLiveAcrossBlocks.test(VirtReg.virtRegIndex()))
     return !MBB->pred_empty();
 
+  if (BeladyEviction)
+    return false;
+
   // See if the first \p Limit def of the register are all in the current block.
   static const unsigned Limit = 8;
   unsigned C = 0;
@@ -824,6 +848,30 @@ unsigned RegAllocFastImpl::calcSpillCost(MCPhysReg PhysReg) const {
   return 0;
 }
 
+/// Return how far above the current instruction the values in PhysReg and its
+/// aliases are referenced next. Allocation runs bottom-up, so evicting the
+/// register with the most distant reference is Belady's choice. A value that
+/// is not referenced above is live-in, and is as good as spilled already.
+unsigned RegAllocFastImpl::calcReuseDistance(MCPhysReg PhysReg) const {
+  unsigned Distance = ~0u;
+  for (MCRegUnit Unit : TRI->regunits(PhysReg)) {
+    unsigned VirtReg = RegUnitStates[Unit];
+    if (VirtReg == regFree || VirtReg == regPreAssigned ||
+        VirtReg == regLiveIn)
+      continue;
+    unsigned RegDistance = CurPos + 1;
+    auto It = BlockRefs.find(Register(VirtReg));
+    if (It != BlockRefs.end()) {
+      const unsigned *Prev = partition_point(
+          It->second, [&](unsigned Pos) { return Pos < CurPos; });
+      if (Prev != It->second.begin())
+        RegDistance = CurPos - Prev[-1];
+    }
+    Distance = std::min(Distance, RegDistance);
+  }
+  return Distance;
+}
+
 void RegAllocFastImpl::assignDanglingDebugValues(MachineInstr &Definition,
                                                  Register VirtReg,
                                                  MCRegister Reg) {
@@ -961,6 +1009,7 @@ void RegAllocFastImpl::allocVirtReg(MachineInstr &MI, LiveReg &LR,
 
   MCPhysReg BestReg = 0;
   unsigned BestCost = spillImpossible;
+  unsigned BestDistance = 0;
   ArrayRef<MCPhysReg> AllocationOrder = RegClassInfo.getOrder(&RC);
   for (MCPhysReg PhysReg : AllocationOrder) {
     LLVM_DEBUG(dbgs() << "\tRegister: " << printReg(PhysReg, TRI) << ' ');
@@ -977,6 +1026,22 @@ void RegAllocFastImpl::allocVirtReg(MachineInstr &MI, LiveReg &LR,
       return;
     }
 
+    if (BeladyEviction) {
+      if (Cost == spillImpossible)
+        continue;
+      // The spill cost only breaks ties between equally distant values.
+      unsigned Distance = calcReuseDistance(PhysReg);
+      if (PhysReg == Hint0 || PhysReg == Hint1)
+        Cost -= spillPrefBonus;
+      if (!BestReg || Distance > BestDistance ||
+          (Distance == BestDistance && Cost < BestCost)) {
+        BestReg = PhysReg;
+        BestCost = Cost;
+        BestDistance = Distance;
+      }
+      continue;
+    }
+
     if (PhysReg == Hint0 || PhysReg == Hint1)
       Cost -= spillPrefBonus;
 
@@ -1775,6 +1840,48 @@ void RegAllocFastImpl::handleBundle(MachineInstr &MI) {
   }
 }
 
+/// Mark every virtual register that is referenced in more than one block as
+/// live across blocks, so mayLiveOut() and mayLiveIn() don't have to guess
+/// for the others.
+void RegAllocFastImpl::scanFunction(const MachineFunction &MF) {
+  SmallVector<const MachineBasicBlock *, 0> BlockOf(MRI->getNumVirtRegs());
+  for (const MachineBasicBlock &MBB : MF) {
+    for (const MachineInstr &MI : MBB) {
+      if (MI.isDebugInstr())
+        continue;
+      for (const MachineOperand &MO : MI.operands()) {
+        if (!MO.isReg() || !MO.getReg().isVirtual())
+          continue;
+        unsigned Idx = MO.getReg().virtRegIndex();
+        if (!BlockOf[Idx])
+          BlockOf[Idx] = &MBB;
+        else if (BlockOf[Idx] != &MBB)
+          MayLiveAcrossBlocks.set(Idx);
+      }
+    }
+  }
+}
+
+/// Number the instructions of \p MBB and record where each virtual register
+/// is referenced, for calcReuseDistance().
+void RegAllocFastImpl::scanBasicBlock(const MachineBasicBlock &MBB) {
+  BlockRefs.clear();
+  unsigned Pos = 0;
+  for (const MachineInstr &MI : MBB) {
+    if (!MI.isDebugInstr()) {
+      for (const MachineOperand &MO : MI.operands()) {
+        if (!MO.isReg() || !MO.getReg().isVirtual())
+          continue;
+        SmallVectorImpl<unsigned> &Refs = BlockRefs[MO.getReg()];
+        if (Refs.empty() || Refs.back() != Pos)
+          Refs.push_back(Pos);
+      }
+    }
+    ++Pos;
+  }
+  CurPos = Pos;
+}
+
 void RegAllocFastImpl::allocateBasicBlock(MachineBasicBlock &MBB) {
   this->MBB = &MBB;
   LLVM_DEBUG(dbgs() << "\nAllocating " << MBB);
@@ -1788,9 +1895,14 @@ void RegAllocFastImpl::allocateBasicBlock(MachineBasicBlock &MBB) {
 
   Coalesced.clear();
 
+  if (BeladyEviction)
+    scanBasicBlock(MBB);
+
   // Traverse block in reverse order allocating instructions one by one.
   for (MachineInstr &MI : reverse(MBB)) {
     LLVM_DEBUG(dbgs() << "\n>> " << MI << "Regs:"; dumpState());
+    if (BeladyEviction)
+      --CurPos;
 
     // Special handling for debug values. Note that they are not allowed to
     // affect codegen of the other instructions in any way.
@@ -1857,6 +1969,8 @@ bool RegAllocFastImpl::runOnMachineFunction(MachineFunction &MF) {
   LiveVirtRegs.setUniverse(NumVirtRegs);
   MayLiveAcrossBlocks.clear();
   MayLiveAcrossBlocks.resize(NumVirtRegs);
+  if (BeladyEviction)
+    scanFunction(MF);
 
   // Loop over all of the basic blocks, eliminating virtual register references
   for (MachineBasicBlock &MBB : MF)
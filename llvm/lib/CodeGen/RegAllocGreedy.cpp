@@ -19,6 +19,7 @@
 #include "llvm/ADT/ArrayRef.h"
 #include "llvm/ADT/BitVector.h"
 #include "llvm/ADT/IndexedMap.h"
+#include "llvm/ADT/SmallPtrSet.h"
 #include "llvm/ADT/SmallSet.h"
 #include "llvm/ADT/SmallVector.h"
 #include "llvm/ADT/Statistic.h"
@@ -132,6 +133,12 @@ static cl::opt<bool> GreedyReverseLocalAssignment(
              "shorter local live ranges will tend to be allocated first"),
     cl::Hidden);
 
+static cl::opt<bool> GreedyBucketQueue(
+    "greedy-bucket-queue",
+    cl::desc("Keep the live ranges waiting for assignment in one heap for "
+             "each stage and class priority instead of a single heap"),
+    cl::init(false), cl::Hidden);
+
 static cl::opt<unsigned> SplitThresholdForRegWithHint(
     "split-threshold-for-reg-with-hint",
     cl::desc("The threshold for splitting a virtual register with a hint, in "
@@ -432,7 +439,7 @@ void RAGreedy::enqueue(PQueue &CurQueue, const LiveInterval *LI) {
 
   // The virtual register number is a tie breaker for same-sized ranges.
   // Give lower vreg numbers higher priority to assign them first.
-  CurQueue.push(std::make_pair(Ret, ~Reg.id()));
+  CurQueue.push(Ret, Reg);
 }
 
 unsigned DefaultPriorityAdvisor::getPriority(const LiveInterval &LI) const {
@@ -518,9 +525,7 @@ const LiveInterval *RAGreedy::dequeue() { return dequeue(Queue); }
 const LiveInterval *RAGreedy::dequeue(PQueue &CurQueue) {
   if (CurQueue.empty())
     return nullptr;
-  LiveInterval *LI = &LIS->getInterval(~CurQueue.top().second);
-  CurQueue.pop();
-  return LI;
+  return &LIS->getInterval(CurQueue.pop());
 }
 
 //===----------------------------------------------------------------------===//
@@ -1682,26 +1687,31 @@ void RAGreedy::calcGapWeights(MCRegister PhysReg,
     // surrounding the instruction. The exception is interference before
     // StartIdx and after StopIdx.
     //
-    LiveIntervalUnion::SegmentIter IntI =
-        Matrix->getLiveUnions()[Unit].find(StartIdx);
-    for (unsigned Gap = 0; IntI.valid() && IntI.start() < StopIdx; ++IntI) {
-      // Skip the gaps before IntI.
-      while (Uses[Gap+1].getBoundaryIndex() < IntI.start())
-        if (++Gap == NumGaps)
+    auto AddWeights = [&](auto IntI) {
+      for (unsigned Gap = 0; IntI.valid() && IntI.start() < StopIdx; ++IntI) {
+        // Skip the gaps before IntI.
+        while (Uses[Gap+1].getBoundaryIndex() < IntI.start())
+          if (++Gap == NumGaps)
+            break;
+        if (Gap == NumGaps)
           break;
-      if (Gap == NumGaps)
-        break;
 
-      // Update the gaps covered by IntI.
-      const float weight = IntI.value()->weight();
-      for (; Gap != NumGaps; ++Gap) {
-        GapWeight[Gap] = std::max(GapWeight[Gap], weight);
-        if (Uses[Gap+1].getBaseIndex() >= IntI.stop())
+        // Update the gaps covered by IntI.
+        const float weight = IntI.value()->weight();
+        for (; Gap != NumGaps; ++Gap) {
+          GapWeight[Gap] = std::max(GapWeight[Gap], weight);
+          if (Uses[Gap+1].getBaseIndex() >= IntI.stop())
+            break;
+        }
+        if (Gap == NumGaps)
           break;
       }
-      if (Gap == NumGaps)
-        break;
-    }
+    };
+    const LiveIntervalUnion &LIU = Matrix->getLiveUnions()[Unit];
+    if (LIU.isFlat())
+      AddWeights(LIU.flatFind(StartIdx));
+    else
+      AddWeights(LIU.find(StartIdx));
   }
 
   // Add fixed interference.
@@ -2923,6 +2933,7 @@ bool RAGreedy::run(MachineFunction &mf) {
                                : TRI->reverseLocalAssignment();
 
   ExtraInfo.emplace();
+  Queue = PQueue(GreedyBucketQueue);
 
   EvictAdvisor = EvictProvider->getAdvisor(*MF, *this, MBFI, Loops);
   PriorityAdvisor = PriorityProvider->getAdvisor(*MF, *this, *Indexes);
@@ -2938,7 +2949,19 @@ bool RAGreedy::run(MachineFunction &mf) {
   SA.reset(new SplitAnalysis(*VRM, *LIS, *Loops));
   SE.reset(new SplitEditor(*SA, *LIS, *VRM, *DomTree, *MBFI, *VRAI));
 
-  IntfCache.init(MF, Matrix->getLiveUnions(), Indexes, LIS, TRI);
+  // Size the interference cache for the longest allocation order in use.
+  unsigned NumOrderRegs = 0;
+  SmallPtrSet<const TargetRegisterClass *, 16> OrderClasses;
+  for (unsigned I = 0, E = MRI->getNumVirtRegs(); I != E; ++I) {
+    Register Reg = Register::index2VirtReg(I);
+    if (MRI->reg_nodbg_empty(Reg) || !shouldAllocateRegister(Reg))
+      continue;
+    const TargetRegisterClass *RC = MRI->getRegClass(Reg);
+    if (OrderClasses.insert(RC).second)
+      NumOrderRegs =
+          std::max(NumOrderRegs, RegClassInfo.getNumAllocatableRegs(RC));
+  }
+  IntfCache.init(MF, Matrix->getLiveUnions(), Indexes, LIS, TRI, NumOrderRegs);
   GlobalCand.resize(32);  // This will grow as needed.
   SetOfBrokenHints.clear();
 
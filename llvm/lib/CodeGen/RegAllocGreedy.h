@@ -36,7 +36,6 @@
 #include <algorithm>
 #include <cstdint>
 #include <memory>
-#include <queue>
 #include <utility>
 
 namespace llvm {
@@ -155,9 +154,54 @@ public:
   bool getReverseLocalAssignment() const { return ReverseLocalAssignment; }
   // end (interface to priority advisers)
 
+  /// Live ranges waiting for assignment, highest priority first, and lowest
+  /// virtual register first among equal priorities.
+  ///
+  /// The queue is a binary heap of (priority, ~reg) keys. When bucketed, there
+  /// is one heap for each value of the top byte of the priority, which holds
+  /// the stage, hint, global and class priority bits of the default priority
+  /// encoding. The ranges are dequeued in the same order either way, but most
+  /// heap operations then only see ranges of the same kind, and the ranges
+  /// that are split or evicted again don't sift through all the others.
+  class PQueue {
+    SmallVector<SmallVector<uint64_t, 0>, 1> Heaps;
+    /// The non-empty heaps.
+    BitVector Occupied;
+    size_t NumEntries = 0;
+
+  public:
+    explicit PQueue(bool Bucketed = false)
+        : Heaps(Bucketed ? 256 : 1), Occupied(Bucketed ? 256 : 1) {}
+
+    bool empty() const { return NumEntries == 0; }
+    size_t size() const { return NumEntries; }
+
+    void push(unsigned Prio, Register Reg) {
+      unsigned Bucket = Heaps.size() == 1 ? 0 : Prio >> 24;
+      SmallVectorImpl<uint64_t> &Heap = Heaps[Bucket];
+      Heap.push_back(uint64_t(Prio) << 32 | ~Reg.id());
+      std::push_heap(Heap.begin(), Heap.end());
+      Occupied.set(Bucket);
+      ++NumEntries;
+    }
+
+    /// Remove the highest priority range, and return its register.
+    Register pop() {
+      assert(!empty() && "Popping an empty queue");
+      unsigned Bucket = Occupied.find_last();
+      SmallVectorImpl<uint64_t> &Heap = Heaps[Bucket];
+      std::pop_heap(Heap.begin(), Heap.end());
+      Register Reg(~uint32_t(Heap.back()));
+      Heap.pop_back();
+      if (Heap.empty())
+        Occupied.reset(Bucket);
+      --NumEntries;
+      return Reg;
+    }
+  };
+
 private:
   // Convenient shortcuts.
-  using PQueue = std::priority_queue<std::pair<unsigned, unsigned>>;
   using SmallLISet = SmallSetVector<const LiveInterval *, 4>;
 
   // We need to track all tentative recolorings so we can roll back any
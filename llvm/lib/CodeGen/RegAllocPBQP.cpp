@@ -34,9 +34,11 @@
 #include "llvm/ADT/BitVector.h"
 #include "llvm/ADT/DenseMap.h"
 #include "llvm/ADT/DenseSet.h"
+#include "llvm/ADT/IntEqClasses.h"
 #include "llvm/ADT/STLExtras.h"
 #include "llvm/ADT/SmallPtrSet.h"
 #include "llvm/ADT/SmallVector.h"
+#include "llvm/ADT/Statistic.h"
 #include "llvm/ADT/StringRef.h"
 #include "llvm/Analysis/AliasAnalysis.h"
 #include "llvm/CodeGen/CalcSpillWeights.h"
@@ -69,10 +71,12 @@
 #include "llvm/Support/Compiler.h"
 #include "llvm/Support/Debug.h"
 #include "llvm/Support/FileSystem.h"
+#include "llvm/Support/Parallel.h"
 #include "llvm/Support/Printable.h"
 #include "llvm/Support/raw_ostream.h"
 #include <algorithm>
 #include <cassert>
+#include <chrono>
 #include <cstddef>
 #include <limits>
 #include <map>
@@ -90,6 +94,8 @@ using namespace llvm;
 
 #define DEBUG_TYPE "regalloc"
 
+STATISTIC(NumGreedyRounds, "Number of PBQP rounds assigned greedily");
+
 static RegisterRegAlloc
 RegisterPBQPRepAlloc("pbqp", "PBQP register allocator",
                        createDefaultPBQPRegisterAllocator);
@@ -99,6 +105,19 @@ PBQPCoalescing("pbqp-coalescing",
                 cl::desc("Attempt coalescing during PBQP register allocation."),
                 cl::init(false), cl::Hidden);
 
+static cl::opt<bool> PBQPParallelComponents(
+    "pbqp-parallel-components",
+    cl::desc("Solve the connected components of the PBQP graph in parallel."),
+    cl::init(false), cl::Hidden);
+
+static cl::opt<unsigned> PBQPTimeBudget(
+    "pbqp-time-budget", cl::value_desc("ms"),
+    cl::desc("Stop searching for the cheapest spill candidates after this many "
+             "milliseconds in a function, and assign the later rounds "
+             "greedily (0 = no limit). Building the graphs and spilling are "
+             "not bounded."),
+    cl::init(0), cl::Hidden);
+
 #ifndef NDEBUG
 static cl::opt<bool>
 PBQPDumpGraphs("pbqp-dump-graphs",
@@ -787,7 +806,110 @@ void RegAllocPBQP::postOptimization(Spiller &VRegSpiller, LiveIntervals &LIS) {
   DeadRemats.clear();
 }
 
+/// Solve the connected components of \p G on the parallel executor. The
+/// components are spread over a few graphs per thread, which share the cost
+/// vectors and matrices of \p G. The solver never reduces a node because of
+/// another component, and the nodes keep their order, so the solution is the
+/// same as solving \p G directly.
+static PBQP::Solution
+solveComponents(PBQPRAGraph &G,
+                PBQP::RegAlloc::RegAllocSolverImpl::TimePoint Deadline) {
+  using NodeId = PBQPRAGraph::NodeId;
+  NodeId NumIds = 0;
+  for (NodeId NId : G.nodeIds())
+    NumIds = std::max(NumIds, NId + 1);
+  IntEqClasses Components(NumIds);
+  for (auto EId : G.edgeIds())
+    Components.join(G.getEdgeNode1Id(EId), G.getEdgeNode2Id(EId));
+  Components.compress();
+
+  size_t NumTasks =
+      std::min<size_t>(Components.getNumClasses(),
+                       4 * parallel::strategy.compute_thread_count());
+  if (NumTasks < 2)
+    return PBQP::RegAlloc::solve(G, Deadline);
+
+  // Give each component to the task with the fewest nodes so far.
+  SmallVector<unsigned, 0> TaskOf(Components.getNumClasses(), ~0u);
+  SmallVector<size_t, 16> TaskSize(NumTasks);
+  SmallVector<NodeId, 0> SubId(NumIds);
+  std::vector<std::unique_ptr<PBQPRAGraph>> Subs;
+  for (size_t I = 0; I != NumTasks; ++I)
+    Subs.push_back(std::make_unique<PBQPRAGraph>(
+        PBQPRAGraph::GraphMetadata(G.getMetadata().MF, G.getMetadata().LIS,
+                                   G.getMetadata().MBFI)));
+  for (NodeId NId : G.nodeIds()) {
+    unsigned &Task = TaskOf[Components[NId]];
+    if (Task == ~0u)
+      Task = llvm::min_element(TaskSize) - TaskSize.begin();
+    ++TaskSize[Task];
+    PBQPRAGraph &Sub = *Subs[Task];
+    SubId[NId] = Sub.addNodeBypassingCostAllocator(G.getNodeCostsPtr(NId));
+    Sub.getNodeMetadata(SubId[NId]) =
+        PBQPRAGraph::NodeMetadata(G.getNodeMetadata(NId));
+  }
+  for (auto EId : G.edgeIds()) {
+    NodeId N1Id = G.getEdgeNode1Id(EId), N2Id = G.getEdgeNode2Id(EId);
+    Subs[TaskOf[Components[N1Id]]]->addEdgeBypassingCostAllocator(
+        SubId[N1Id], SubId[N2Id], G.getEdgeCostsPtr(EId));
+  }
+
+  // The costs of G stay referenced, so the solvers never release them into
+  // the shared pools of G.
+  std::vector<PBQP::Solution> SubSolutions(NumTasks);
+  parallelFor(0, NumTasks, [&](size_t Task) {
+    SubSolutions[Task] = PBQP::RegAlloc::solve(*Subs[Task], Deadline);
+  });
+
+  PBQP::Solution Solution;
+  for (NodeId NId : G.nodeIds())
+    Solution.setSelection(NId, SubSolutions[TaskOf[Components[NId]]]
+                                   .getSelection(SubId[NId]));
+  return Solution;
+}
+
+/// Pick an option for every node of \p G, most expensive to spill first: the
+/// cheapest one given the options of the neighbors picked before it. This
+/// takes one pass over the edges instead of a reduction of the graph.
+static PBQP::Solution solveGreedily(PBQPRAGraph &G) {
+  using NodeId = PBQPRAGraph::NodeId;
+  const PBQP::PBQPNum Inf = std::numeric_limits<PBQP::PBQPNum>::infinity();
+  SmallVector<NodeId, 0> Order(G.nodeIds().begin(), G.nodeIds().end());
+  llvm::stable_sort(Order, [&](NodeId A, NodeId B) {
+    return G.getNodeCosts(A)[PBQP::RegAlloc::getSpillOptionIdx()] >
+           G.getNodeCosts(B)[PBQP::RegAlloc::getSpillOptionIdx()];
+  });
+
+  PBQP::Solution Solution;
+  DenseMap<NodeId, unsigned> Picked;
+  for (NodeId NId : Order) {
+    PBQPRAGraph::RawVector Costs(G.getNodeCosts(NId));
+    for (auto EId : G.adjEdgeIds(NId)) {
+      bool IsNode1 = G.getEdgeNode1Id(EId) == NId;
+      NodeId Other = IsNode1 ? G.getEdgeNode2Id(EId) : G.getEdgeNode1Id(EId);
+      auto It = Picked.find(Other);
+      if (It == Picked.end())
+        continue;
+      const PBQPRAGraph::Matrix &M = G.getEdgeCosts(EId);
+      for (unsigned Opt = 0, E = Costs.getLength(); Opt != E; ++Opt)
+        Costs[Opt] += IsNode1 ? M[Opt][It->second] : M[It->second][Opt];
+    }
+    // Spilling stays possible when every register is taken.
+    unsigned Best = PBQP::RegAlloc::getSpillOptionIdx();
+    for (unsigned Opt = 0, E = Costs.getLength(); Opt != E; ++Opt)
+      if (Costs[Opt] != Inf && Costs[Opt] < Costs[Best])
+        Best = Opt;
+    Picked[NId] = Best;
+    Solution.setSelection(NId, Best);
+  }
+  return Solution;
+}
+
 bool RegAllocPBQP::runOnMachineFunction(MachineFunction &MF) {
+  auto Deadline = PBQP::RegAlloc::RegAllocSolverImpl::TimePoint::max();
+  if (PBQPTimeBudget)
+    Deadline = std::chrono::steady_clock::now() +
+               std::chrono::milliseconds(PBQPTimeBudget);
   LiveIntervals &LIS = getAnalysis<LiveIntervalsWrapperPass>().getLIS();
   MachineBlockFrequencyInfo &MBFI =
       getAnalysis<MachineBlockFrequencyInfoWrapperPass>().getMBFI();
@@ -868,7 +990,18 @@ bool RegAllocPBQP::runOnMachineFunction(MachineFunction &MF) {
       }
 #endif
 
-      PBQP::Solution Solution = PBQP::RegAlloc::solve(G);
+      // The budget bounds the reduction of the graph of each round, and the
+      // number of rounds that are solved. It doesn't bound the wall time.
+      PBQP::Solution Solution;
+      if (PBQPTimeBudget && std::chrono::steady_clock::now() > Deadline) {
+        LLVM_DEBUG(dbgs() << "  Over the time budget, assigning greedily\n");
+        Solution = solveGreedily(G);
+        ++NumGreedyRounds;
+      } else if (PBQPParallelComponents) {
+        Solution = solveComponents(G, Deadline);
+      } else {
+        Solution = PBQP::RegAlloc::solve(G, Deadline);
+      }
       PBQPAllocComplete = mapPBQPToRegAlloc(G, Solution, VRM, *VRegSpiller);
       ++Round;
     }
@@ -5,202 +5,622 @@
 // SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
 //
 //===----------------------------------------------------------------------===//
-//
-// REALISTIC ANALYZER:
-// 1. Calculates Base Pressure (Chordal Graph).
-// 2. Simulates ABI Constraints:
-//    - Variables live across CALLs must fit in Callee-Saved Regs.
-//    - If they don't fit, they SPILL.
-//
+///
+/// \file
+/// This file defines the RASSA function pass, a register allocator that colors
+/// live ranges in dominator tree order.
+///
+/// The pass can also print a pressure report for each function, predicting
+/// the spills caused by the calling convention:
+///  1. Compute the exact MaxLive of each register class.
+///  2. Values of classes that share registers, e.g. RISC-V vector values of
+///     different LMULs, must fit in the units of their pressure sets
+///     together, or they are counted as spills.
+///  3. Values live across calls must fit in the registers preserved by the
+///     call regmasks, or they are counted as spills.
+///  4. Each callee-saved register the allocation needs costs a save in the
+///     prologue and a restore in every epilogue, weighted by block frequency.
+///
 //===----------------------------------------------------------------------===//
 
+#include "RegAllocSSA.h"
+#include "AllocationOrder.h"
+#include "SSACoalescer.h"
+#include "SSAConstraintSplitter.h"
+#include "SSASpiller.h"
+#include "llvm/ADT/DepthFirstIterator.h"
+#include "llvm/ADT/SmallPtrSet.h"
+#include "llvm/ADT/Statistic.h"
+#include "llvm/Analysis/AliasAnalysis.h"
+#include "llvm/Analysis/ProfileSummaryInfo.h"
+#include "llvm/CodeGen/CalcSpillWeights.h"
+#include "llvm/CodeGen/LiveDebugVariables.h"
 #include "llvm/CodeGen/LiveIntervals.h"
-#include "llvm/CodeGen/MachineFunctionPass.h"
+#include "llvm/CodeGen/LiveRegMatrix.h"
+#include "llvm/CodeGen/LiveStacks.h"
+#include "llvm/CodeGen/MachineBlockFrequencyInfo.h"
+#include "llvm/CodeGen/MachineDominators.h"
+#include "llvm/CodeGen/MachineLoopInfo.h"
 #include "llvm/CodeGen/MachineRegisterInfo.h"
+#include "llvm/CodeGen/MaxLive.h"
 #include "llvm/CodeGen/Passes.h"
 #include "llvm/CodeGen/RegAllocRegistry.h"
+#include "llvm/CodeGen/TargetInstrInfo.h"
 #include "llvm/CodeGen/TargetRegisterInfo.h"
-#include "llvm/InitializePasses.h" 
+#include "llvm/CodeGen/TargetSubtargetInfo.h"
+#include "llvm/CodeGen/VirtRegMap.h"
+#include "llvm/InitializePasses.h"
 #include "llvm/Pass.h"
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/Debug.h"
+#include "llvm/Support/Format.h"
 #include "llvm/Support/raw_ostream.h"
-#include <vector>
 #include <algorithm>
-#include <map>
-#include <set>
+#include <functional>
+#include <vector>
 
 using namespace llvm;
 
-FunctionPass *llvm::createSSARegisterAllocator();
+#define DEBUG_TYPE "regalloc"
 
-static RegisterRegAlloc ssaRegAlloc("ssa", "SSA register allocator",
-                                      createSSARegisterAllocator);
+STATISTIC(NumPressureSpills,
+          "Number of live ranges spilled by the SSA allocator");
 
-namespace {
-class RASSA : public MachineFunctionPass {
-public:
-  static char ID;
-  RASSA() : MachineFunctionPass(ID) {}
-  StringRef getPassName() const override { return "SSA Register Allocator Analyzer"; }
-  void getAnalysisUsage(AnalysisUsage &AU) const override {
-    AU.setPreservesAll();
-    AU.addRequired<LiveIntervalsWrapperPass>();
-    MachineFunctionPass::getAnalysisUsage(AU);
-  }
+static cl::opt<bool>
+    SSARegAllocReport("ssa-regalloc-report", cl::Hidden, cl::init(false),
+                      cl::desc("Print @SSA_REPORT register pressure lines "
+                               "from the SSA register allocator"));
 
-  struct RegisterStats {
-    unsigned MaxPressure = 0;
-    unsigned SpillCount = 0;
-    unsigned TotalPhysRegs = 0;
-    unsigned CalleeSavedLimit = 12; 
-  };
+static cl::opt<bool>
+    SSAPreSpill("ssa-regalloc-prespill", cl::Hidden, cl::init(true),
+                cl::desc("Lower register pressure with Belady spilling before "
+                         "coloring in the SSA register allocator"));
 
-  bool runOnMachineFunction(MachineFunction &MF) override;
-  void simulateChordalAllocation(MachineFunction &MF);
+static cl::opt<bool>
+    SSARecolor("ssa-regalloc-recolor", cl::Hidden, cl::init(true),
+               cl::desc("Remove copies by affinity recoloring after SSA "
+                        "register allocation"));
+
+static cl::opt<bool> SSASplitConstraints(
+    "ssa-regalloc-split-constraints", cl::Hidden, cl::init(true),
+    cl::desc("Split live ranges around instructions with fixed register "
+             "operands before SSA register allocation"));
+
+static cl::opt<bool> SSAFitGroups(
+    "ssa-regalloc-fit-groups", cl::Hidden, cl::init(true),
+    cl::desc("Prefer registers that keep register groups free in the SSA "
+             "register allocator"));
+
+static RegisterRegAlloc ssaRegAlloc("ssa", "SSA register allocator",
+                                    createSSARegisterAllocator);
 
-private:
-  LiveIntervals *LIS = nullptr;
-  const TargetRegisterInfo *TRI = nullptr;
-  MachineRegisterInfo *MRI = nullptr;
-};
 char RASSA::ID = 0;
-} 
 
-namespace llvm {
-  void initializeRASSAPass(PassRegistry&);
-  void initializeLiveIntervalsWrapperPassPass(PassRegistry&);
+INITIALIZE_PASS_BEGIN(RASSA, "regallocssa", "SSA Register Allocator", false,
+                      false)
+INITIALIZE_PASS_DEPENDENCY(LiveDebugVariablesWrapperLegacy)
+INITIALIZE_PASS_DEPENDENCY(SlotIndexesWrapperPass)
+INITIALIZE_PASS_DEPENDENCY(LiveIntervalsWrapperPass)
+INITIALIZE_PASS_DEPENDENCY(RegisterCoalescerLegacy)
+INITIALIZE_PASS_DEPENDENCY(MachineSchedulerLegacy)
+INITIALIZE_PASS_DEPENDENCY(LiveStacksWrapperLegacy)
+INITIALIZE_PASS_DEPENDENCY(AAResultsWrapperPass)
+INITIALIZE_PASS_DEPENDENCY(MachineDominatorTreeWrapperPass)
+INITIALIZE_PASS_DEPENDENCY(MachineLoopInfoWrapperPass)
+INITIALIZE_PASS_DEPENDENCY(VirtRegMapWrapperLegacy)
+INITIALIZE_PASS_DEPENDENCY(LiveRegMatrixWrapperLegacy)
+INITIALIZE_PASS_DEPENDENCY(ProfileSummaryInfoWrapperPass)
+INITIALIZE_PASS_END(RASSA, "regallocssa", "SSA Register Allocator", false,
+                    false)
+
+bool RASSA::LRE_CanEraseVirtReg(Register VirtReg) {
+  LiveInterval &LI = LIS->getInterval(VirtReg);
+  if (VRM->hasPhys(VirtReg)) {
+    Matrix->unassign(LI);
+    aboutToRemoveInterval(LI);
+    return true;
+  }
+  // Unassigned virtreg is probably in the priority queue.
+  // RegAllocBase will erase it after dequeueing.
+  LI.clear();
+  return false;
 }
 
-INITIALIZE_PASS_BEGIN(RASSA, "regallocssa", "SSA Register Allocator", false, false)
-INITIALIZE_PASS_DEPENDENCY(LiveIntervalsWrapperPass)
-INITIALIZE_PASS_END(RASSA, "regallocssa", "SSA Register Allocator", false, false)
+void RASSA::LRE_WillShrinkVirtReg(Register VirtReg) {
+  if (!VRM->hasPhys(VirtReg))
+    return;
 
-bool RASSA::runOnMachineFunction(MachineFunction &MF) {
-  LIS = &getAnalysis<LiveIntervalsWrapperPass>().getLIS();
-  TRI = MF.getSubtarget().getRegisterInfo();
-  MRI = &MF.getRegInfo();
-  simulateChordalAllocation(MF);
-  return false;
+  // Register is assigned, put it back on the queue for reassignment.
+  LiveInterval &LI = LIS->getInterval(VirtReg);
+  Matrix->unassign(LI);
+  enqueue(&LI);
 }
 
-void RASSA::simulateChordalAllocation(MachineFunction &MF) {
-  std::map<const TargetRegisterClass *, RegisterStats> ClassStats;
-  std::vector<const LiveInterval *> Intervals;
+RASSA::RASSA(RegAllocFilterFunc F) : MachineFunctionPass(ID), RegAllocBase(F) {}
+
+void RASSA::getAnalysisUsage(AnalysisUsage &AU) const {
+  AU.setPreservesCFG();
+  AU.addRequired<AAResultsWrapperPass>();
+  AU.addPreserved<AAResultsWrapperPass>();
+  AU.addRequired<LiveIntervalsWrapperPass>();
+  AU.addPreserved<LiveIntervalsWrapperPass>();
+  AU.addPreserved<SlotIndexesWrapperPass>();
+  AU.addRequired<LiveDebugVariablesWrapperLegacy>();
+  AU.addPreserved<LiveDebugVariablesWrapperLegacy>();
+  AU.addRequired<LiveStacksWrapperLegacy>();
+  AU.addPreserved<LiveStacksWrapperLegacy>();
+  AU.addRequired<ProfileSummaryInfoWrapperPass>();
+  AU.addRequired<MachineBlockFrequencyInfoWrapperPass>();
+  AU.addPreserved<MachineBlockFrequencyInfoWrapperPass>();
+  AU.addRequired<MachineDominatorTreeWrapperPass>();
+  AU.addPreserved<MachineDominatorTreeWrapperPass>();
+  AU.addRequired<MachineLoopInfoWrapperPass>();
+  AU.addPreserved<MachineLoopInfoWrapperPass>();
+  AU.addRequired<VirtRegMapWrapperLegacy>();
+  AU.addPreserved<VirtRegMapWrapperLegacy>();
+  AU.addRequired<LiveRegMatrixWrapperLegacy>();
+  AU.addPreserved<LiveRegMatrixWrapperLegacy>();
+  MachineFunctionPass::getAnalysisUsage(AU);
+}
 
-  // --- STEP 0: Configure Limits based on Architecture ---
-  // If RV32E is detected (16 regs total), the saved pool is tiny.
-  bool isRV32E = MF.getSubtarget().getFeatureString().contains("+e");
-  unsigned savedRegLimit = isRV32E ? 2 : 12; // s0-s1 vs s0-s11
-
-  // --- STEP 1: Find all Call Sites ---
-  std::vector<SlotIndex> CallSites;
-  for (const MachineBasicBlock &MBB : MF) {
-    for (const MachineInstr &MI : MBB) {
-      if (MI.isCall()) {
-        CallSites.push_back(LIS->getInstructionIndex(MI));
-      }
-    }
-  }
+void RASSA::releaseMemory() {
+  SpillerInstance.reset();
+  DomOrder.clear();
+  OrderRegs.clear();
+  Groups.clear();
+  Queue = {};
+}
 
-  // --- STEP 2: Collect Virtual Intervals ---
-  for (unsigned i = 0, e = MRI->getNumVirtRegs(); i != e; ++i) {
-    Register Reg = Register::index2VirtReg(i);
-    if (MRI->reg_nodbg_empty(Reg)) continue; 
-    
+void RASSA::collectOrderRegs() {
+  OrderRegs.clear();
+  OrderRegs.resize(TRI->getNumRegs());
+  SmallPtrSet<const TargetRegisterClass *, 16> Classes;
+  for (unsigned I = 0, E = MRI->getNumVirtRegs(); I != E; ++I) {
+    Register Reg = Register::index2VirtReg(I);
+    if (MRI->reg_nodbg_empty(Reg) || !shouldAllocateRegister(Reg))
+      continue;
     const TargetRegisterClass *RC = MRI->getRegClass(Reg);
+    if (Classes.insert(RC).second)
+      for (MCPhysReg PhysReg : RegClassInfo.getOrder(RC))
+        OrderRegs.set(PhysReg);
+  }
+}
 
-    // FIXED: Removed !TRI->isAllocatableClass(RC)
-    // Instead, we check the bitvector below.
-    BitVector Allocatable = TRI->getAllocatableSet(MF, RC);
-    if (Allocatable.none()) continue; // If 0 allocatable regs, ignore this class
+ArrayRef<MCRegister> RASSA::getGroups(const TargetRegisterClass *RC,
+                                      MCRegister PhysReg) {
+  auto [It, Inserted] = Groups.try_emplace({RC, PhysReg});
+  if (!Inserted)
+    return It->second;
+  // A super-register that only covers PhysReg in RC, like a 64-bit register
+  // over its 32-bit half, is not a group.
+  for (MCPhysReg Super : TRI->superregs(PhysReg))
+    if (OrderRegs.test(Super) &&
+        count_if(TRI->subregs(Super),
+                 [&](MCPhysReg Sub) { return RC->contains(Sub); }) >= 2)
+      It->second.push_back(Super);
+  return It->second;
+}
 
-    Intervals.push_back(&LIS->getInterval(Reg));
+unsigned RASSA::countFreeGroups(const LiveInterval &VirtReg,
+                                MCRegister PhysReg) {
+  const TargetRegisterClass *RC = MRI->getRegClass(VirtReg.reg());
+  return count_if(getGroups(RC, PhysReg), [&](MCRegister Group) {
+    return Matrix->checkInterference(VirtReg, Group) == LiveRegMatrix::IK_Free;
+  });
+}
 
-    if (ClassStats.find(RC) == ClassStats.end()) {
-      ClassStats[RC].TotalPhysRegs = Allocatable.count();
-      ClassStats[RC].CalleeSavedLimit = savedRegLimit;
-    }
+void RASSA::computeDomOrder() {
+  // Blocks that are not reachable from the entry keep the largest number, so
+  // their live ranges are colored last.
+  DomOrder.assign(MF->getNumBlockIDs(), MF->getNumBlockIDs());
+  unsigned Num = 0;
+  for (MachineDomTreeNode *Node : depth_first(MDT->getRootNode()))
+    DomOrder[Node->getBlock()->getNumber()] = Num++;
+}
+
+void RASSA::enqueueImpl(const LiveInterval *LI) {
+  // Empty live ranges have no position in the dominator tree. They cannot
+  // interfere with anything, so color them first.
+  if (LI->empty()) {
+    Queue.push({0, LIS->getSlotIndexes()->getZeroIndex(), LI->reg()});
+    return;
   }
+  SlotIndex Start = LI->beginIndex();
+  const MachineBasicBlock *MBB = LIS->getMBBFromIndex(Start);
+  Queue.push({DomOrder[MBB->getNumber()], Start, LI->reg()});
+}
 
-  // --- STEP 3: Sort (Linear Scan) ---
-  std::sort(Intervals.begin(), Intervals.end(),
-            [](const LiveInterval *A, const LiveInterval *B) {
-              return A->beginIndex() < B->beginIndex();
-            });
+const LiveInterval *RASSA::dequeue() {
+  if (Queue.empty())
+    return nullptr;
+  Register Reg = std::get<2>(Queue.top());
+  Queue.pop();
+  return &LIS->getInterval(Reg);
+}
 
-  // --- STEP 4: Simulation ---
-  std::map<const TargetRegisterClass *, std::vector<const LiveInterval *>> ActiveIntervals;
-  std::map<const TargetRegisterClass *, std::vector<const LiveInterval *>> ActiveAcrossCalls;
+// Spill all live virtual registers currently unified under PhysReg that
+// interfere with VirtReg. The new live intervals produced by the spiller are
+// appended to SplitVRegs.
+bool RASSA::spillInterferences(const LiveInterval &VirtReg, MCRegister PhysReg,
+                               SmallVectorImpl<Register> &SplitVRegs) {
+  // Record each interference and determine if all are spillable before mutating
+  // either the union or live intervals.
+  SmallVector<const LiveInterval *, 8> Intfs;
+  for (MCRegUnit Unit : TRI->regunits(PhysReg)) {
+    LiveIntervalUnion::Query &Q = Matrix->query(VirtReg, Unit);
+    for (const auto *Intf : reverse(Q.interferingVRegs())) {
+      if (!Intf->isSpillable())
+        return false;
+      Intfs.push_back(Intf);
+    }
+  }
+  assert(!Intfs.empty() && "expected interference");
+  LLVM_DEBUG(dbgs() << "spilling " << printReg(PhysReg, TRI)
+                    << " interferences with " << VirtReg << "\n");
+
+  for (const LiveInterval *Spill : Intfs) {
+    // Skip duplicates.
+    if (!VRM->hasPhys(Spill->reg()))
+      continue;
+    Matrix->unassign(*Spill);
+    LiveRangeEdit LRE(Spill, SplitVRegs, *MF, *LIS, VRM, this, &DeadRemats);
+    spiller().spill(LRE);
+    ++NumPressureSpills;
+  }
+  return true;
+}
 
-  for (const LiveInterval *Current : Intervals) {
-    const TargetRegisterClass *RC = MRI->getRegClass(Current->reg());
-    RegisterStats &Stats = ClassStats[RC];
-    auto &ActiveList = ActiveIntervals[RC];
-    auto &CallList = ActiveAcrossCalls[RC]; 
-
-    // 4a. Expire Old Intervals
-    auto It = std::remove_if(ActiveList.begin(), ActiveList.end(),
-                             [&](const LiveInterval *Active) {
-                               return Active->endIndex() <= Current->beginIndex();
-                             });
-    ActiveList.erase(It, ActiveList.end());
-
-    auto CallIt = std::remove_if(CallList.begin(), CallList.end(),
-                             [&](const LiveInterval *Active) {
-                               return Active->endIndex() <= Current->beginIndex();
-                             });
-    CallList.erase(CallIt, CallList.end());
-
-
-    // 4b. Add New Interval
-    ActiveList.push_back(Current);
-
-    // 4c. Check if THIS interval crosses any Call Site
-    bool crossesCall = false;
-    for (SlotIndex CallIdx : CallSites) {
-      // FIXED: Used liveAt() instead of covers()
-      if (Current->liveAt(CallIdx)) {
-        crossesCall = true;
-        break;
+// Every live range is colored exactly once, with the first register of the
+// allocation order that is free over the whole range. Since the queue follows
+// the dominator tree, each register freed by a dead value can be reused by the
+// values defined below it. A hint is taken whenever it is free; otherwise
+// registers that are parts of register groups are chosen to break as few free
+// groups as possible.
+//
+// A live range that finds no free register is spilled. The only exception are
+// the tiny unspillable ranges created by the spiller around each use; they
+// make room for themselves by spilling the ranges that interfere with them.
+MCRegister RASSA::selectOrSplit(const LiveInterval &VirtReg,
+                                SmallVectorImpl<Register> &SplitVRegs) {
+  SmallVector<MCRegister, 8> PhysRegSpillCands;
+  MCRegister BestReg;
+  unsigned BestFreeGroups = ~0u;
+
+  auto Order =
+      AllocationOrder::create(VirtReg.reg(), *VRM, RegClassInfo, Matrix);
+  for (auto I = Order.begin(), E = Order.end(); I != E; ++I) {
+    MCRegister PhysReg = *I;
+    assert(PhysReg.isValid());
+    switch (Matrix->checkInterference(VirtReg, PhysReg)) {
+    case LiveRegMatrix::IK_Free: {
+      if (!SSAFitGroups || I.isHint())
+        return PhysReg;
+      unsigned FreeGroups = countFreeGroups(VirtReg, PhysReg);
+      if (!FreeGroups)
+        return PhysReg;
+      if (FreeGroups < BestFreeGroups) {
+        BestReg = PhysReg;
+        BestFreeGroups = FreeGroups;
       }
+      continue;
     }
 
-    if (crossesCall) {
-        CallList.push_back(Current);
+    case LiveRegMatrix::IK_VirtReg:
+      PhysRegSpillCands.push_back(PhysReg);
+      continue;
+
+    default:
+      // RegMask or RegUnit interference.
+      continue;
     }
+  }
+
+  if (BestReg)
+    return BestReg;
+
+  if (VirtReg.isSpillable()) {
+    LLVM_DEBUG(dbgs() << "spilling: " << VirtReg << '\n');
+    LiveRangeEdit LRE(&VirtReg, SplitVRegs, *MF, *LIS, VRM, this, &DeadRemats);
+    spiller().spill(LRE);
+    ++NumPressureSpills;
+    return 0;
+  }
+
+  for (MCRegister PhysReg : PhysRegSpillCands) {
+    if (!spillInterferences(VirtReg, PhysReg, SplitVRegs))
+      continue;
 
-    // --- REALISTIC PRESSURE CHECK ---
-    unsigned globalPressure = ActiveList.size();
-    if (globalPressure > Stats.MaxPressure) {
-      Stats.MaxPressure = globalPressure;
+    assert(!Matrix->checkInterference(VirtReg, PhysReg) &&
+           "Interference after spill.");
+    return PhysReg;
+  }
+
+  return ~0u;
+}
+
+namespace {
+/// The allocatable registers of a class, as seen by the calling convention.
+struct ClassABI {
+  unsigned NumRegs = 0;
+  /// Registers in the callee-saved list of the function. Each one that is
+  /// used must be saved and restored by the prologue and epilogues.
+  unsigned NumCalleeSaved = 0;
+  /// Registers preserved by every call in the function. A value that is live
+  /// across a call must be in one of them or be spilled.
+  unsigned NumPreserved = 0;
+};
+} // end anonymous namespace
+
+static ClassABI computeClassABI(ArrayRef<MCPhysReg> Order,
+                                const BitVector &CalleeSaved,
+                                ArrayRef<const uint32_t *> CallMasks) {
+  ClassABI ABI;
+  ABI.NumRegs = Order.size();
+  for (MCPhysReg PhysReg : Order) {
+    bool IsCalleeSaved = CalleeSaved.test(PhysReg);
+    ABI.NumCalleeSaved += IsCalleeSaved;
+    // Without calls, the callee-saved registers stand in for the preserved
+    // ones; they only matter for values live across a call anyway.
+    if (CallMasks.empty()) {
+      ABI.NumPreserved += IsCalleeSaved;
+      continue;
     }
+    ABI.NumPreserved += none_of(CallMasks, [&](const uint32_t *Mask) {
+      return MachineOperand::clobbersPhysReg(Mask, PhysReg);
+    });
+  }
+  return ABI;
+}
 
-    // ABI Bottleneck Check
-    bool forcedSpill = false;
-    if (CallList.size() > Stats.CalleeSavedLimit) {
-        forcedSpill = true;
+void RASSA::simulateChordalAllocation(MachineFunction &MF,
+                                      const MachineBlockFrequencyInfo &MBFI) {
+  const TargetInstrInfo &TII = *MF.getSubtarget().getInstrInfo();
+  struct RegisterStats {
+    unsigned SpillCount = 0;
+    unsigned RematCount = 0;
+    unsigned MaxAcrossCalls = 0;
+    /// Colored values that are live, and those that are live across calls.
+    unsigned Active = 0;
+    unsigned ActiveAcrossCalls = 0;
+    ClassABI ABI;
+    bool Used = false;
+  };
+  SmallVector<RegisterStats, 32> ClassStats(TRI->getNumRegClasses());
+  std::vector<const LiveInterval *> Intervals;
+
+  // A register counts as callee-saved if it overlaps an entry of the list,
+  // e.g. the 32-bit half of a saved 64-bit register.
+  BitVector CalleeSaved(TRI->getNumRegs());
+  for (const MCPhysReg *CSR = MRI->getCalleeSavedRegs(); CSR && *CSR; ++CSR)
+    for (MCRegAliasIterator AI(*CSR, TRI, /*IncludeSelf=*/true); AI.isValid();
+         ++AI)
+      CalleeSaved.set(*AI);
+  ArrayRef<const uint32_t *> CallMasks = LIS->getRegMaskBits();
+
+  // PEI saves callee-saved registers in the entry block and restores them in
+  // every returning block.
+  double SaveRestoreFreq = 1.0;
+  for (const MachineBasicBlock &MBB : MF)
+    if (MBB.isReturnBlock())
+      SaveRestoreFreq += MBFI.getBlockFreqRelativeToEntryBlock(&MBB);
+
+  for (unsigned I = 0, E = MRI->getNumVirtRegs(); I != E; ++I) {
+    Register Reg = Register::index2VirtReg(I);
+    if (MRI->reg_nodbg_empty(Reg) || !shouldAllocateRegister(Reg))
+      continue;
+
+    const TargetRegisterClass *RC = MRI->getRegClass(Reg);
+    unsigned NumRegs = RegClassInfo.getNumAllocatableRegs(RC);
+    if (!NumRegs)
+      continue;
+
+    const LiveInterval &LI = LIS->getInterval(Reg);
+    if (LI.empty())
+      continue;
+    Intervals.push_back(&LI);
+    RegisterStats &Stats = ClassStats[RC->getID()];
+    if (!Stats.Used) {
+      Stats.Used = true;
+      Stats.ABI =
+          computeClassABI(RegClassInfo.getOrder(RC), CalleeSaved, CallMasks);
     }
+  }
 
-    bool standardSpill = (globalPressure > Stats.TotalPhysRegs);
+  llvm::sort(Intervals, [](const LiveInterval *A, const LiveInterval *B) {
+    return A->beginIndex() < B->beginIndex();
+  });
+
+  // Classes that share registers, like the LMUL groups of RISC-V vector
+  // registers and the single registers they are made of, also share the units
+  // of their pressure sets. A value occupies the weight of its class in each.
+  unsigned NumPSets = TRI->getNumRegPressureSets();
+  SmallVector<unsigned, 16> PSetActive(NumPSets), PSetMax(NumPSets);
+  BitVector PSetUsed(NumPSets);
+  auto PSets = [&](const TargetRegisterClass *RC) {
+    SmallVector<unsigned, 4> Result;
+    for (const int *PSet = TRI->getRegClassPressureSets(RC); *PSet != -1;
+         ++PSet)
+      Result.push_back(*PSet);
+    return Result;
+  };
 
-    if (forcedSpill || standardSpill) {
-      Stats.SpillCount++;
-      ActiveList.pop_back(); 
-      if (forcedSpill && !CallList.empty()) CallList.pop_back(); 
+  // The colored intervals by end index, as a min-heap, so expiring the
+  // intervals that end before the current one is logarithmic.
+  using ActiveEntry = std::pair<SlotIndex, const LiveInterval *>;
+  SmallVector<ActiveEntry, 32> Active;
+  auto ByEnd = [](const ActiveEntry &A, const ActiveEntry &B) {
+    return A.first > B.first;
+  };
+
+  for (const LiveInterval *Current : Intervals) {
+    while (!Active.empty() && Active.front().first <= Current->beginIndex()) {
+      const LiveInterval *Expired = Active.front().second;
+      std::pop_heap(Active.begin(), Active.end(), ByEnd);
+      Active.pop_back();
+      const TargetRegisterClass *RC = MRI->getRegClass(Expired->reg());
+      RegisterStats &Stats = ClassStats[RC->getID()];
+      --Stats.Active;
+      Stats.ActiveAcrossCalls -= LIS->crossesCall(*Expired);
+      for (unsigned PSet : PSets(RC))
+        PSetActive[PSet] -= TRI->getRegClassWeight(RC).RegWeight;
+    }
+
+    const TargetRegisterClass *RC = MRI->getRegClass(Current->reg());
+    RegisterStats &Stats = ClassStats[RC->getID()];
+    unsigned Weight = TRI->getRegClassWeight(RC).RegWeight;
+    SmallVector<unsigned, 4> CurrentPSets = PSets(RC);
+
+    // Values live across calls are limited by the registers the calls
+    // preserve. A value that doesn't fit is spilled and leaves the active
+    // sets.
+    bool CrossesCall = LIS->crossesCall(*Current);
+    bool ForcedSpill =
+        CrossesCall && Stats.ActiveAcrossCalls + 1 > Stats.ABI.NumPreserved;
+    bool StandardSpill =
+        Stats.Active + 1 > Stats.ABI.NumRegs ||
+        any_of(CurrentPSets, [&](unsigned PSet) {
+          return PSetActive[PSet] + Weight >
+                 RegClassInfo.getRegPressureSetLimit(PSet);
+        });
+    if (ForcedSpill || StandardSpill) {
+      // A constant or a frame address is recomputed, not stored.
+      if (SSASpiller::getRematDef(Current->reg(), *MRI, TII))
+        ++Stats.RematCount;
+      else
+        ++Stats.SpillCount;
+      continue;
+    }
+    Active.push_back({Current->endIndex(), Current});
+    std::push_heap(Active.begin(), Active.end(), ByEnd);
+    ++Stats.Active;
+    for (unsigned PSet : CurrentPSets) {
+      PSetActive[PSet] += Weight;
+      PSetMax[PSet] = std::max(PSetMax[PSet], PSetActive[PSet]);
+      PSetUsed.set(PSet);
+    }
+    if (CrossesCall) {
+      ++Stats.ActiveAcrossCalls;
+      Stats.MaxAcrossCalls =
+          std::max(Stats.MaxAcrossCalls, Stats.ActiveAcrossCalls);
     }
   }
 
-  // --- STEP 5: Output ---
-  for (auto &Pair : ClassStats) {
-    const TargetRegisterClass *RC = Pair.first;
-    RegisterStats &Stats = Pair.second;
+  // The reported pressure is the exact MaxLive, which doesn't count the holes
+  // of the live intervals.
+  MaxLive ML;
+  ML.compute(MF, *LIS, *MDT);
+  for (unsigned ClassID = 0, E = ClassStats.size(); ClassID != E; ++ClassID) {
+    const RegisterStats &Stats = ClassStats[ClassID];
+    if (!Stats.Used)
+      continue;
+    const TargetRegisterClass *RC = TRI->getRegClass(ClassID);
+    unsigned Pressure = ML.getMaxLive(*RC);
+
+    // The allocation order puts the callee-saved registers last, so they are
+    // needed for the values live across calls, and for the pressure that
+    // doesn't fit in the caller-saved registers.
+    const ClassABI &ABI = Stats.ABI;
+    unsigned NumCallerSaved = ABI.NumRegs - ABI.NumCalleeSaved;
+    unsigned NumCSRs = std::max(Stats.MaxAcrossCalls,
+                                Pressure > NumCallerSaved
+                                    ? Pressure - NumCallerSaved
+                                    : 0);
+    NumCSRs = std::min(NumCSRs, ABI.NumCalleeSaved);
 
     errs() << "@SSA_REPORT "
            << "func=" << MF.getName() << " "
+           << "class=" << TRI->getRegClassName(RC) << " "
            << "spills=" << Stats.SpillCount << " "
-           << "pressure=" << Stats.MaxPressure << "\n";
+           << "pressure=" << Pressure << " "
+           << "csrs=" << NumCSRs << " "
+           << "csr_cost=" << format("%.2f", NumCSRs * SaveRestoreFreq) << " "
+           << "weight=" << TRI->getRegClassWeight(RC).RegWeight << " "
+           << "remats=" << Stats.RematCount << "\n";
   }
-  errs().flush(); 
+
+  // The combined pressure of the classes that share registers, in register
+  // units, e.g. the sum of the LMULs of the live vector values.
+  for (unsigned PSet : PSetUsed.set_bits())
+    errs() << "@SSA_PSET "
+           << "func=" << MF.getName() << " "
+           << "pset=" << TRI->getRegPressureSetName(PSet) << " "
+           << "units=" << PSetMax[PSet] << " "
+           << "limit=" << RegClassInfo.getRegPressureSetLimit(PSet) << "\n";
+}
+
+bool RASSA::runOnMachineFunction(MachineFunction &mf) {
+  LLVM_DEBUG(dbgs() << "********** SSA REGISTER ALLOCATION **********\n"
+                    << "********** Function: " << mf.getName() << '\n');
+
+  MF = &mf;
+  MDT = &getAnalysis<MachineDominatorTreeWrapperPass>().getDomTree();
+  auto &MBFI = getAnalysis<MachineBlockFrequencyInfoWrapperPass>().getMBFI();
+  auto &LiveStks = getAnalysis<LiveStacksWrapperLegacy>().getLS();
+
+  RegAllocBase::init(getAnalysis<VirtRegMapWrapperLegacy>().getVRM(),
+                     getAnalysis<LiveIntervalsWrapperPass>().getLIS(),
+                     getAnalysis<LiveRegMatrixWrapperLegacy>().getLRM());
+
+  if (SSARegAllocReport)
+    simulateChordalAllocation(mf, MBFI);
+
+  const MachineLoopInfo &Loops =
+      getAnalysis<MachineLoopInfoWrapperPass>().getLI();
+  if (SSAPreSpill) {
+    SSASpiller Spiller(
+        *MF, *LIS, LiveStks, *VRM, Loops, MBFI, RegClassInfo,
+        [this](Register Reg) { return shouldAllocateRegister(Reg); });
+    Spiller.run();
+    if (SSARegAllocReport)
+      errs() << "@SSA_SPILL func=" << mf.getName()
+             << " spills=" << Spiller.getNumSpills()
+             << " reloads=" << Spiller.getNumReloads()
+             << " remats=" << Spiller.getNumRemats() << "\n";
+  }
+
+  VirtRegAuxInfo VRAI(*MF, *LIS, *VRM, Loops, MBFI,
+                      &getAnalysis<ProfileSummaryInfoWrapperPass>().getPSI());
+  VRAI.calculateSpillWeightsAndHints();
+
+  SpillerInstance.reset(
+      createInlineSpiller({*LIS, LiveStks, *MDT, MBFI}, *MF, *VRM, VRAI));
+
+  if (SSASplitConstraints) {
+    SSAConstraintSplitter Splitter(
+        *MF, *LIS, *VRM, Loops, *MDT, MBFI, VRAI,
+        getAnalysis<LiveDebugVariablesWrapperLegacy>().getLDV(), RegClassInfo,
+        [this](Register Reg) { return shouldAllocateRegister(Reg); });
+    auto [NumSplits, NumCopies] = Splitter.run();
+    if (SSARegAllocReport)
+      errs() << "@SSA_SPLIT func=" << mf.getName() << " ranges=" << NumSplits
+             << " copies=" << NumCopies << "\n";
+  }
+
+  computeDomOrder();
+  if (SSAFitGroups)
+    collectOrderRegs();
+  allocatePhysRegs();
+
+  if (SSARecolor) {
+    SSACoalescer Coalescer(
+        *MF, *LIS, *VRM, *Matrix, MBFI, RegClassInfo,
+        [this](Register Reg) { return shouldAllocateRegister(Reg); });
+    auto [NumRemoved, NumBroken, DynCopies] = Coalescer.run();
+    if (SSARegAllocReport)
+      errs() << "@SSA_COALESCE func=" << mf.getName()
+             << " copies=" << NumRemoved << " broken=" << NumBroken
+             << " dynamic=" << format("%.2f", DynCopies) << "\n";
+  }
+  postOptimization();
+
+  LLVM_DEBUG(dbgs() << "Post alloc VirtRegMap:\n" << *VRM << "\n");
+
+  releaseMemory();
+  return true;
 }
 
 FunctionPass *llvm::createSSARegisterAllocator() { return new RASSA(); }
-FunctionPass *llvm::createSSARegisterAllocator(RegAllocFilterFunc F) { return new RASSA(); }
\ No newline at end of file
+
+FunctionPass *llvm::createSSARegisterAllocator(RegAllocFilterFunc F) {
+  return new RASSA(F);
+}
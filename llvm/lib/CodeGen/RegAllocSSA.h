@@ -0,0 +1,154 @@
+//===-- RegAllocSSA.h - SSA Register Allocator Header -----------*- C++ -*-===//
+//
+// Part of the LLVM Project, under the Apache License v2.0 with LLVM Exceptions.
+// See https://llvm.org/LICENSE.txt for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+//
+//===----------------------------------------------------------------------===//
+///
+/// \file
+/// This file declares the RASSA class, a register allocator that colors live
+/// ranges in dominance order, following the SSA-based allocation approach.
+///
+//===----------------------------------------------------------------------===//
+
+#ifndef LLVM_LIB_CODEGEN_REGALLOCSSA_H
+#define LLVM_LIB_CODEGEN_REGALLOCSSA_H
+
+#include "RegAllocBase.h"
+#include "llvm/ADT/BitVector.h"
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/CodeGen/LiveRangeEdit.h"
+#include "llvm/CodeGen/MachineFunctionPass.h"
+#include "llvm/CodeGen/SlotIndexes.h"
+#include "llvm/CodeGen/Spiller.h"
+#include <functional>
+#include <queue>
+#include <tuple>
+
+namespace llvm {
+
+class MachineBlockFrequencyInfo;
+class MachineDominatorTree;
+
+/// RASSA assigns physical registers to live virtual registers in the order
+/// their definitions are reached by a preorder walk of the dominator tree.
+///
+/// This is a first-fit heuristic. For strict SSA programs the interference
+/// graph is chordal and first-fit along this order needs no more registers than
+/// the maximum number of live values. The input here is not strict SSA: PHI
+/// elimination and two-address lowering have run, and the reloads of the
+/// SSASpiller redefine values. The SSASpiller still lowers the pressure to the
+/// number of registers first, so few live ranges are left without a color.
+/// The SSAConstraintSplitter then splits the live ranges that cross
+/// instructions with fixed register operands, such as calls and the copies of
+/// ABI registers, so the constraints only apply to short pieces joined by
+/// parallel copies. A live range that still cannot be colored is spilled by
+/// the inline spiller. Afterwards the SSACoalescer recolors affine live ranges
+/// to remove copies.
+///
+/// Classes whose registers are combined into wider register groups, such as
+/// the aligned LMUL>1 groups of RISC-V vector registers, are not covered by
+/// that bound: first-fit can scatter narrow values so that no aligned group is
+/// left free. Among the free registers of a live range, the allocator picks
+/// one that breaks the fewest groups that are still free.
+///
+/// The allocator runs in the regular register allocation slot, after PHI
+/// elimination, so the PHI operands already appear as copies at the end of the
+/// predecessor blocks. Interference is still checked through LiveRegMatrix,
+/// which keeps the assignment correct for live ranges that are no longer in
+/// SSA form, e.g. after coalescing or two-address lowering.
+class LLVM_LIBRARY_VISIBILITY RASSA : public MachineFunctionPass,
+                                      public RegAllocBase,
+                                      private LiveRangeEdit::Delegate {
+  // context
+  MachineFunction *MF = nullptr;
+  MachineDominatorTree *MDT = nullptr;
+
+  // state
+  std::unique_ptr<Spiller> SpillerInstance;
+
+  /// Preorder number of each basic block in the dominator tree.
+  SmallVector<unsigned, 32> DomOrder;
+
+  /// Queue entries are ordered by the dominance position of the first def.
+  using QueueEntry = std::tuple<unsigned, SlotIndex, Register>;
+  std::priority_queue<QueueEntry, std::vector<QueueEntry>,
+                      std::greater<QueueEntry>>
+      Queue;
+
+  /// Registers in the allocation orders of the classes being allocated.
+  BitVector OrderRegs;
+
+  /// The register groups that contain each register of a class: the
+  /// registers of OrderRegs that cover it and at least one other register of
+  /// the class, e.g. the LMUL=2 groups of RISC-V vector registers.
+  DenseMap<std::pair<const TargetRegisterClass *, MCRegister>,
+           SmallVector<MCRegister, 4>>
+      Groups;
+
+  bool LRE_CanEraseVirtReg(Register) override;
+  void LRE_WillShrinkVirtReg(Register) override;
+
+  /// Number the blocks of MF in dominator tree preorder.
+  void computeDomOrder();
+
+  /// Collect OrderRegs from the classes of the virtual registers to allocate.
+  void collectOrderRegs();
+
+  /// Return the register groups of class \p RC that contain \p PhysReg.
+  ArrayRef<MCRegister> getGroups(const TargetRegisterClass *RC,
+                                 MCRegister PhysReg);
+
+  /// Return the number of groups containing \p PhysReg that are free over
+  /// the whole of \p VirtReg, and would be broken by assigning it PhysReg.
+  unsigned countFreeGroups(const LiveInterval &VirtReg, MCRegister PhysReg);
+
+  /// Print the predicted register pressure, spill counts and callee-saved
+  /// register costs of MF.
+  void simulateChordalAllocation(MachineFunction &MF,
+                                 const MachineBlockFrequencyInfo &MBFI);
+
+  /// Spill all live virtual registers assigned to PhysReg or an alias that
+  /// interfere with VirtReg. Return false if any of them is unspillable.
+  bool spillInterferences(const LiveInterval &VirtReg, MCRegister PhysReg,
+                          SmallVectorImpl<Register> &SplitVRegs);
+
+public:
+  RASSA(const RegAllocFilterFunc F = nullptr);
+
+  /// Return the pass name.
+  StringRef getPassName() const override { return "SSA Register Allocator"; }
+
+  /// RASSA analysis usage.
+  void getAnalysisUsage(AnalysisUsage &AU) const override;
+
+  void releaseMemory() override;
+
+  Spiller &spiller() override { return *SpillerInstance; }
+
+  void enqueueImpl(const LiveInterval *LI) override;
+
+  const LiveInterval *dequeue() override;
+
+  MCRegister selectOrSplit(const LiveInterval &VirtReg,
+                           SmallVectorImpl<Register> &SplitVRegs) override;
+
+  /// Perform register allocation.
+  bool runOnMachineFunction(MachineFunction &mf) override;
+
+  MachineFunctionProperties getRequiredProperties() const override {
+    return MachineFunctionProperties().set(
+        MachineFunctionProperties::Property::NoPHIs);
+  }
+
+  MachineFunctionProperties getClearedProperties() const override {
+    return MachineFunctionProperties().set(
+        MachineFunctionProperties::Property::IsSSA);
+  }
+
+  static char ID;
+};
+} // namespace llvm
+#endif
@@ -10,17 +10,30 @@
 /// Currently, the score is the sum of the machine basic block frequency-weighed
 /// number of loads, stores, copies, and remat instructions, each factored with
 /// a relative weight.
+///
+/// The RegAllocScoreReport pass computes the score after any register
+/// allocator and reports it as an analysis remark and as statistics. It is
+/// added to the pipeline with -regalloc-score-report.
 //===----------------------------------------------------------------------===//
 
 #include "RegAllocScore.h"
+#include "llvm/ADT/Statistic.h"
+#include "llvm/Analysis/OptimizationRemarkEmitter.h"
+#include "llvm/CodeGen/LazyMachineBlockFrequencyInfo.h"
 #include "llvm/CodeGen/MachineBasicBlock.h"
 #include "llvm/CodeGen/MachineBlockFrequencyInfo.h"
 #include "llvm/CodeGen/MachineFunction.h"
+#include "llvm/CodeGen/MachineFunctionPass.h"
 #include "llvm/CodeGen/MachineInstr.h"
+#include "llvm/CodeGen/MachineOptimizationRemarkEmitter.h"
+#include "llvm/CodeGen/Passes.h"
 #include "llvm/CodeGen/TargetInstrInfo.h"
 #include "llvm/CodeGen/TargetSubtargetInfo.h"
+#include "llvm/IR/DebugInfoMetadata.h"
+#include "llvm/InitializePasses.h"
 #include "llvm/MC/MCInstrDesc.h"
 #include "llvm/Support/CommandLine.h"
+#include <cmath>
 
 using namespace llvm;
 
@@ -39,6 +52,14 @@ LLVM_ABI cl::opt<double> ExpensiveRematWeight("regalloc-expensive-remat-weight",
 
 #define DEBUG_TYPE "regalloc-score"
 
+STATISTIC(TotalScore, "Sum of the register allocation scores, rounded");
+STATISTIC(WeightedCopies,
+          "Copies after register allocation, weighted by block frequency");
+STATISTIC(WeightedLoads,
+          "Loads after register allocation, weighted by block frequency");
+STATISTIC(WeightedStores,
+          "Stores after register allocation, weighted by block frequency");
+
 RegAllocScore &RegAllocScore::operator+=(const RegAllocScore &Other) {
   CopyCounts += Other.copyCounts();
   LoadCounts += Other.loadCounts();
@@ -122,3 +143,74 @@ RegAllocScore llvm::calculateRegAllocScore(
   }
   return Total;
 }
+
+namespace {
+class RegAllocScoreReport : public MachineFunctionPass {
+public:
+  static char ID;
+
+  RegAllocScoreReport() : MachineFunctionPass(ID) {
+    initializeRegAllocScoreReportPass(*PassRegistry::getPassRegistry());
+  }
+
+  StringRef getPassName() const override {
+    return "Register Allocation Score Report";
+  }
+
+  void getAnalysisUsage(AnalysisUsage &AU) const override {
+    AU.setPreservesAll();
+    AU.addRequired<LazyMachineBlockFrequencyInfoPass>();
+    AU.addRequired<MachineOptimizationRemarkEmitterPass>();
+    MachineFunctionPass::getAnalysisUsage(AU);
+  }
+
+  bool runOnMachineFunction(MachineFunction &MF) override;
+};
+} // end anonymous namespace
+
+char RegAllocScoreReport::ID = 0;
+char &llvm::RegAllocScoreReportID = RegAllocScoreReport::ID;
+
+INITIALIZE_PASS_BEGIN(RegAllocScoreReport, "regalloc-score-report",
+                      "Register Allocation Score Report", false, false)
+INITIALIZE_PASS_DEPENDENCY(LazyMachineBlockFrequencyInfoPass)
+INITIALIZE_PASS_DEPENDENCY(MachineOptimizationRemarkEmitterPass)
+INITIALIZE_PASS_END(RegAllocScoreReport, "regalloc-score-report",
+                    "Register Allocation Score Report", false, false)
+
+bool RegAllocScoreReport::runOnMachineFunction(MachineFunction &MF) {
+  // Block frequencies are only computed when someone asks for the score.
+  auto &ORE = getAnalysis<MachineOptimizationRemarkEmitterPass>().getORE();
+  if (!AreStatisticsEnabled() && !ORE.allowExtraAnalysis(DEBUG_TYPE))
+    return false;
+
+  RegAllocScore Score = calculateRegAllocScore(
+      MF, getAnalysis<LazyMachineBlockFrequencyInfoPass>().getBFI());
+  TotalScore += std::llround(Score.getScore());
+  WeightedCopies += std::llround(Score.copyCounts());
+  WeightedLoads += std::llround(Score.loadCounts() + Score.loadStoreCounts());
+  WeightedStores += std::llround(Score.storeCounts() + Score.loadStoreCounts());
+
+  ORE.emit([&]() {
+    using namespace ore;
+    DebugLoc Loc;
+    if (auto *SP = MF.getFunction().getSubprogram())
+      Loc = DILocation::get(SP->getContext(), SP->getLine(), 1, SP);
+    MachineOptimizationRemarkAnalysis R(DEBUG_TYPE, "RegAllocScore", Loc,
+                                        &MF.front());
+    // Remark arguments are printed as floats.
+    auto Weighted = [](StringRef Key, double Count) {
+      return NV(Key, static_cast<float>(Count));
+    };
+    R << "register allocation score " << Weighted("Score", Score.getScore())
+      << " from " << Weighted("Copies", Score.copyCounts()) << " copies, "
+      << Weighted("Loads", Score.loadCounts()) << " loads, "
+      << Weighted("Stores", Score.storeCounts()) << " stores, "
+      << Weighted("LoadStores", Score.loadStoreCounts()) << " load-stores, "
+      << Weighted("CheapRemats", Score.cheapRematCounts()) << " cheap and "
+      << Weighted("ExpensiveRemats", Score.expensiveRematCounts())
+      << " expensive rematerializations, weighted by block frequency";
+    return R;
+  });
+  return false;
+}
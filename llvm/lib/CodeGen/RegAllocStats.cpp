@@ -0,0 +1,160 @@
+//===- RegAllocStats.cpp - Allocation statistics --------------------------===//
+//
+// Part of the LLVM Project, under the Apache License v2.0 with LLVM Exceptions.
+// See https://llvm.org/LICENSE.txt for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+//
+//===----------------------------------------------------------------------===//
+
+#include "llvm/CodeGen/RegAllocStats.h"
+#include "RegAllocScore.h"
+#include "llvm/ADT/STLExtras.h"
+#include "llvm/CodeGen/MachineBlockFrequencyInfo.h"
+#include "llvm/CodeGen/MachineFrameInfo.h"
+#include "llvm/CodeGen/MachineFunction.h"
+#include "llvm/CodeGen/MachineFunctionPass.h"
+#include "llvm/CodeGen/MachineMemOperand.h"
+#include "llvm/CodeGen/PseudoSourceValue.h"
+#include "llvm/CodeGen/TargetInstrInfo.h"
+#include "llvm/CodeGen/TargetSubtargetInfo.h"
+#include "llvm/InitializePasses.h"
+#include "llvm/Support/Timer.h"
+
+using namespace llvm;
+
+#define DEBUG_TYPE "regalloc-stats"
+
+RegAllocFunctionStats
+llvm::computeRegAllocStats(const MachineFunction &MF,
+                           const MachineBlockFrequencyInfo &MBFI) {
+  const TargetInstrInfo &TII = *MF.getSubtarget().getInstrInfo();
+  const MachineFrameInfo &MFI = MF.getFrameInfo();
+  auto IsSpillSlotAccess = [&](const MachineMemOperand *MMO) {
+    const auto *PSV =
+        dyn_cast_or_null<FixedStackPseudoSourceValue>(MMO->getPseudoValue());
+    return PSV && MFI.isSpillSlotObjectIndex(PSV->getFrameIndex());
+  };
+
+  RegAllocFunctionStats Stats;
+  Stats.Name = MF.getName().str();
+  for (const MachineBasicBlock &MBB : MF) {
+    for (const MachineInstr &MI : MBB) {
+      if (TII.isCopyInstr(MI)) {
+        ++Stats.Copies;
+        continue;
+      }
+      int FI;
+      SmallVector<const MachineMemOperand *, 2> Accesses;
+      if ((TII.isLoadFromStackSlot(MI, FI) && MFI.isSpillSlotObjectIndex(FI)) ||
+          (TII.hasLoadFromStackSlot(MI, Accesses) &&
+           any_of(Accesses, IsSpillSlotAccess)))
+        ++Stats.Reloads;
+      Accesses.clear();
+      if ((TII.isStoreToStackSlot(MI, FI) && MFI.isSpillSlotObjectIndex(FI)) ||
+          (TII.hasStoreToStackSlot(MI, Accesses) &&
+           any_of(Accesses, IsSpillSlotAccess)))
+        ++Stats.Spills;
+    }
+  }
+  Stats.Score = calculateRegAllocScore(MF, MBFI).getScore();
+  return Stats;
+}
+
+char RegAllocStatsSink::ID = 0;
+
+INITIALIZE_PASS(RegAllocStatsSink, "regalloc-stats-sink",
+                "Register Allocation Statistics Sink", false, true)
+
+RegAllocStatsSink::RegAllocStatsSink(
+    std::vector<RegAllocFunctionStats> *Records)
+    : ImmutablePass(ID), Records(Records) {
+  initializeRegAllocStatsSinkPass(*PassRegistry::getPassRegistry());
+}
+
+void RegAllocStatsSink::startTimer() {
+  StartTime = TimeRecord::getCurrentTime(/*Start=*/true).getWallTime();
+  Started = true;
+}
+
+void RegAllocStatsSink::record(RegAllocFunctionStats Stats) {
+  if (Started)
+    Stats.WallTime =
+        TimeRecord::getCurrentTime(/*Start=*/false).getWallTime() - StartTime;
+  if (!Records)
+    return;
+  if (!Records->empty() && Records->back().Name == Stats.Name)
+    Records->back() = std::move(Stats);
+  else
+    Records->push_back(std::move(Stats));
+}
+
+namespace {
+class RegAllocStatsTimer : public MachineFunctionPass {
+public:
+  static char ID;
+
+  RegAllocStatsTimer() : MachineFunctionPass(ID) {
+    initializeRegAllocStatsTimerPass(*PassRegistry::getPassRegistry());
+  }
+
+  StringRef getPassName() const override {
+    return "Register Allocation Statistics Timer";
+  }
+
+  void getAnalysisUsage(AnalysisUsage &AU) const override {
+    AU.setPreservesAll();
+    AU.addRequired<RegAllocStatsSink>();
+    MachineFunctionPass::getAnalysisUsage(AU);
+  }
+
+  bool runOnMachineFunction(MachineFunction &) override {
+    getAnalysis<RegAllocStatsSink>().startTimer();
+    return false;
+  }
+};
+
+class RegAllocStatsCollector : public MachineFunctionPass {
+public:
+  static char ID;
+
+  RegAllocStatsCollector() : MachineFunctionPass(ID) {
+    initializeRegAllocStatsCollectorPass(*PassRegistry::getPassRegistry());
+  }
+
+  StringRef getPassName() const override {
+    return "Register Allocation Statistics Collector";
+  }
+
+  void getAnalysisUsage(AnalysisUsage &AU) const override {
+    AU.setPreservesAll();
+    AU.addRequired<RegAllocStatsSink>();
+    AU.addRequired<MachineBlockFrequencyInfoWrapperPass>();
+    MachineFunctionPass::getAnalysisUsage(AU);
+  }
+
+  bool runOnMachineFunction(MachineFunction &MF) override {
+    getAnalysis<RegAllocStatsSink>().record(computeRegAllocStats(
+        MF, getAnalysis<MachineBlockFrequencyInfoWrapperPass>().getMBFI()));
+    return false;
+  }
+};
+} // end anonymous namespace
+
+char RegAllocStatsTimer::ID = 0;
+char &llvm::RegAllocStatsTimerID = RegAllocStatsTimer::ID;
+
+INITIALIZE_PASS_BEGIN(RegAllocStatsTimer, "regalloc-stats-timer",
+                      "Register Allocation Statistics Timer", false, false)
+INITIALIZE_PASS_DEPENDENCY(RegAllocStatsSink)
+INITIALIZE_PASS_END(RegAllocStatsTimer, "regalloc-stats-timer",
+                    "Register Allocation Statistics Timer", false, false)
+
+char RegAllocStatsCollector::ID = 0;
+char &llvm::RegAllocStatsCollectorID = RegAllocStatsCollector::ID;
+
+INITIALIZE_PASS_BEGIN(RegAllocStatsCollector, "regalloc-stats-collector",
+                      "Register Allocation Statistics Collector", false, false)
+INITIALIZE_PASS_DEPENDENCY(RegAllocStatsSink)
+INITIALIZE_PASS_DEPENDENCY(MachineBlockFrequencyInfoWrapperPass)
+INITIALIZE_PASS_END(RegAllocStatsCollector, "regalloc-stats-collector",
+                    "Register Allocation Statistics Collector", false, false)
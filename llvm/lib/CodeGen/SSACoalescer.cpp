@@ -0,0 +1,313 @@
+//===- SSACoalescer.cpp - Affinity recoloring for the SSA allocator -------===//
+//
+// Part of the LLVM Project, under the Apache License v2.0 with LLVM Exceptions.
+// See https://llvm.org/LICENSE.txt for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+//
+//===----------------------------------------------------------------------===//
+//
+// Recoloring works on chunks, heaviest first. For every register in the
+// allocation order, the members of the chunk are moved to that register where
+// it is free. A member blocked by another live range can still move if that
+// live range can be moved to some other free register. The register with the
+// largest gain in satisfied copy frequency, counting the copies of every live
+// range that moved, is kept, and the members that received it are locked.
+//
+//===----------------------------------------------------------------------===//
+
+#include "SSACoalescer.h"
+#include "llvm/ADT/STLExtras.h"
+#include "llvm/ADT/Sequence.h"
+#include "llvm/ADT/Statistic.h"
+#include "llvm/CodeGen/LiveInterval.h"
+#include "llvm/CodeGen/LiveIntervalUnion.h"
+#include "llvm/CodeGen/LiveIntervals.h"
+#include "llvm/CodeGen/LiveRegMatrix.h"
+#include "llvm/CodeGen/MachineBlockFrequencyInfo.h"
+#include "llvm/CodeGen/MachineFunction.h"
+#include "llvm/CodeGen/MachineRegisterInfo.h"
+#include "llvm/CodeGen/RegisterClassInfo.h"
+#include "llvm/CodeGen/TargetRegisterInfo.h"
+#include "llvm/CodeGen/TargetSubtargetInfo.h"
+#include "llvm/CodeGen/VirtRegMap.h"
+#include "llvm/Support/Debug.h"
+#include "llvm/Support/raw_ostream.h"
+
+using namespace llvm;
+
+#define DEBUG_TYPE "regalloc"
+
+STATISTIC(NumAffinities, "Number of copies considered for recoloring");
+STATISTIC(NumRecolored, "Number of copies removed by SSA recoloring");
+STATISTIC(NumBroken, "Number of identity copies broken by SSA recoloring");
+
+SSACoalescer::SSACoalescer(MachineFunction &MF, LiveIntervals &LIS,
+                           VirtRegMap &VRM, LiveRegMatrix &Matrix,
+                           const MachineBlockFrequencyInfo &MBFI,
+                           const RegisterClassInfo &RegClassInfo,
+                           std::function<bool(Register)> ShouldAllocate)
+    : MF(MF), LIS(LIS), VRM(VRM), Matrix(Matrix), MBFI(MBFI),
+      RegClassInfo(RegClassInfo), TRI(*MF.getSubtarget().getRegisterInfo()),
+      ShouldAllocate(std::move(ShouldAllocate)) {}
+
+bool SSACoalescer::isRecolorable(Register Reg) const {
+  return Reg.isVirtual() && VRM.hasPhys(Reg) && ShouldAllocate(Reg) &&
+         LIS.hasInterval(Reg) && !LIS.getInterval(Reg).empty();
+}
+
+MCRegister SSACoalescer::getColor(Register Reg) const {
+  return Reg.isPhysical() ? Reg.asMCReg() : VRM.getPhys(Reg);
+}
+
+bool SSACoalescer::isSatisfied(const Affinity &Aff) const {
+  return getColor(Aff.A) == getColor(Aff.B);
+}
+
+void SSACoalescer::collectAffinities() {
+  for (const MachineBasicBlock &MBB : MF) {
+    double Freq = MBFI.getBlockFreqRelativeToEntryBlock(&MBB);
+    // Copies bundled into a parallel copy are affinities of their own.
+    for (const MachineInstr &MI : MBB.instrs()) {
+      if (!MI.isCopy() || MI.getOperand(0).getSubReg() ||
+          MI.getOperand(1).getSubReg())
+        continue;
+      Register A = MI.getOperand(0).getReg();
+      Register B = MI.getOperand(1).getReg();
+      if (!isRecolorable(A))
+        std::swap(A, B);
+      if (A == B || !isRecolorable(A) || !getColor(B))
+        continue;
+      unsigned Idx = Affinities.size();
+      Affinities.push_back({A, B, Freq});
+      AffinitiesOf[A].push_back(Idx);
+      if (isRecolorable(B))
+        AffinitiesOf[B].push_back(Idx);
+    }
+  }
+  NumAffinities += Affinities.size();
+}
+
+bool SSACoalescer::interferes(const Chunk &A, const Chunk &B) const {
+  for (Register RegA : A.Regs)
+    for (Register RegB : B.Regs)
+      if (Packed.find(RegA)->second.overlaps(Packed.find(RegB)->second))
+        return true;
+  return false;
+}
+
+// Merge affine live ranges greedily, heaviest copy first, as long as the
+// members of a chunk don't interfere and can share a register.
+void SSACoalescer::buildChunks() {
+  const MachineRegisterInfo &MRI = MF.getRegInfo();
+  auto GetChunk = [&](Register Reg) {
+    auto [It, Inserted] = ChunkOf.try_emplace(Reg, Chunks.size());
+    if (Inserted)
+      Chunks.emplace_back().Regs.push_back(Reg);
+    return It->second;
+  };
+
+  for (const Affinity &Aff : Affinities)
+    for (Register Reg : {Aff.A, Aff.B})
+      if (isRecolorable(Reg))
+        Packed.try_emplace(Reg, LIS.getInterval(Reg));
+
+  auto Order = llvm::to_vector<32>(llvm::seq<unsigned>(0, Affinities.size()));
+  llvm::stable_sort(Order, [&](unsigned L, unsigned R) {
+    return Affinities[L].Weight > Affinities[R].Weight;
+  });
+  for (unsigned Idx : Order) {
+    const Affinity &Aff = Affinities[Idx];
+    unsigned ChunkA = GetChunk(Aff.A);
+    if (!isRecolorable(Aff.B))
+      continue;
+    unsigned ChunkB = GetChunk(Aff.B);
+    if (ChunkA == ChunkB ||
+        !TRI.getCommonSubClass(MRI.getRegClass(Chunks[ChunkA].Regs.front()),
+                               MRI.getRegClass(Chunks[ChunkB].Regs.front())) ||
+        interferes(Chunks[ChunkA], Chunks[ChunkB]))
+      continue;
+    if (Chunks[ChunkA].Regs.size() < Chunks[ChunkB].Regs.size())
+      std::swap(ChunkA, ChunkB);
+    for (Register Reg : Chunks[ChunkB].Regs)
+      ChunkOf[Reg] = ChunkA;
+    Chunks[ChunkA].Regs.append(Chunks[ChunkB].Regs);
+    Chunks[ChunkB].Regs.clear();
+  }
+
+  for (const Affinity &Aff : Affinities) {
+    unsigned ChunkA = ChunkOf.lookup(Aff.A);
+    Chunks[ChunkA].Weight += Aff.Weight;
+    auto It = ChunkOf.find(Aff.B);
+    if (It != ChunkOf.end() && It->second != ChunkA)
+      Chunks[It->second].Weight += Aff.Weight;
+  }
+}
+
+void SSACoalescer::reassign(const LiveInterval &LI, MCRegister PhysReg) {
+  Changes.push_back({LI.reg(), VRM.getPhys(LI.reg())});
+  Matrix.unassign(LI);
+  Matrix.assign(LI, PhysReg);
+}
+
+void SSACoalescer::undo(unsigned Mark) {
+  while (Changes.size() > Mark) {
+    auto [Reg, PhysReg] = Changes.pop_back_val();
+    const LiveInterval &LI = LIS.getInterval(Reg);
+    Matrix.unassign(LI);
+    Matrix.assign(LI, PhysReg);
+  }
+}
+
+// Move LI to a free register that doesn't overlap PhysReg.
+bool SSACoalescer::moveAside(const LiveInterval &LI, MCRegister PhysReg,
+                             const Chunk &Owner) {
+  Register Reg = LI.reg();
+  if (!isRecolorable(Reg) || Locked.contains(Reg) ||
+      is_contained(Owner.Regs, Reg))
+    return false;
+  MCRegister Current = VRM.getPhys(Reg);
+  for (MCRegister Alt :
+       RegClassInfo.getOrder(MF.getRegInfo().getRegClass(Reg))) {
+    if (Alt == Current || TRI.regsOverlap(Alt, PhysReg))
+      continue;
+    if (Matrix.checkInterference(LI, Alt) == LiveRegMatrix::IK_Free) {
+      reassign(LI, Alt);
+      return true;
+    }
+  }
+  return false;
+}
+
+void SSACoalescer::tryColor(const Chunk &C, MCRegister PhysReg) {
+  const MachineRegisterInfo &MRI = MF.getRegInfo();
+  for (Register Reg : C.Regs) {
+    if (Locked.contains(Reg) || VRM.getPhys(Reg) == PhysReg ||
+        !is_contained(RegClassInfo.getOrder(MRI.getRegClass(Reg)), PhysReg))
+      continue;
+    const LiveInterval &LI = LIS.getInterval(Reg);
+    switch (Matrix.checkInterference(LI, PhysReg)) {
+    case LiveRegMatrix::IK_Free:
+      reassign(LI, PhysReg);
+      continue;
+    case LiveRegMatrix::IK_VirtReg:
+      break;
+    default:
+      // Fixed registers can't be moved.
+      continue;
+    }
+
+    SmallVector<const LiveInterval *, 4> Intfs;
+    for (MCRegUnit Unit : TRI.regunits(PhysReg))
+      for (const LiveInterval *Intf :
+           Matrix.query(LI, Unit).interferingVRegs())
+        if (Intf != &LI && !is_contained(Intfs, Intf))
+          Intfs.push_back(Intf);
+
+    unsigned Mark = Changes.size();
+    bool Moved = llvm::all_of(Intfs, [&](const LiveInterval *Intf) {
+      return moveAside(*Intf, PhysReg, C);
+    });
+    if (Moved &&
+        Matrix.checkInterference(LI, PhysReg) == LiveRegMatrix::IK_Free)
+      reassign(LI, PhysReg);
+    else
+      undo(Mark);
+  }
+}
+
+// Return the change in satisfied copy frequency caused by the assignments
+// changed since Mark.
+double SSACoalescer::getGain(unsigned Mark) const {
+  DenseMap<Register, MCRegister> OldColor;
+  for (auto [Reg, PhysReg] : ArrayRef(Changes).drop_front(Mark))
+    OldColor.try_emplace(Reg, PhysReg);
+  auto GetOldColor = [&](Register Reg) {
+    auto It = OldColor.find(Reg);
+    return It != OldColor.end() ? It->second : getColor(Reg);
+  };
+
+  double Gain = 0;
+  DenseSet<unsigned> Seen;
+  for (const auto &Entry : OldColor) {
+    auto It = AffinitiesOf.find(Entry.first);
+    if (It == AffinitiesOf.end())
+      continue;
+    for (unsigned Idx : It->second) {
+      if (!Seen.insert(Idx).second)
+        continue;
+      const Affinity &Aff = Affinities[Idx];
+      bool Before = GetOldColor(Aff.A) == GetOldColor(Aff.B);
+      if (isSatisfied(Aff) != Before)
+        Gain += Before ? -Aff.Weight : Aff.Weight;
+    }
+  }
+  return Gain;
+}
+
+void SSACoalescer::recolor(const Chunk &C) {
+  const TargetRegisterClass *RC =
+      MF.getRegInfo().getRegClass(C.Regs.front());
+  double BestGain = 0;
+  MCRegister BestReg;
+  for (MCRegister PhysReg : RegClassInfo.getOrder(RC)) {
+    tryColor(C, PhysReg);
+    double Gain = getGain(0);
+    undo(0);
+    if (Gain > BestGain) {
+      BestGain = Gain;
+      BestReg = PhysReg;
+    }
+  }
+  if (!BestReg)
+    return;
+
+  LLVM_DEBUG(dbgs() << "recolor chunk of " << C.Regs.size() << " to "
+                    << printReg(BestReg, &TRI) << ", gain " << BestGain
+                    << '\n');
+  tryColor(C, BestReg);
+  Changes.clear();
+  for (Register Reg : C.Regs)
+    if (VRM.getPhys(Reg) == BestReg)
+      Locked.insert(Reg);
+}
+
+std::tuple<unsigned, unsigned, double> SSACoalescer::run() {
+  collectAffinities();
+  if (Affinities.empty())
+    return {0, 0, 0};
+
+  SmallVector<bool, 32> WasSatisfied;
+  for (const Affinity &Aff : Affinities)
+    WasSatisfied.push_back(isSatisfied(Aff));
+
+  buildChunks();
+  SmallVector<unsigned, 16> Order;
+  for (unsigned I = 0, E = Chunks.size(); I != E; ++I)
+    if (!Chunks[I].Regs.empty())
+      Order.push_back(I);
+  llvm::stable_sort(Order, [&](unsigned L, unsigned R) {
+    return Chunks[L].Weight > Chunks[R].Weight;
+  });
+  for (unsigned I : Order)
+    recolor(Chunks[I]);
+
+  // Recoloring a chunk can move a register away from a copy that was already
+  // an identity copy. Those count against the copies removed.
+  unsigned NumRemoved = 0, NumAdded = 0;
+  double Freq = 0;
+  for (unsigned I = 0, E = Affinities.size(); I != E; ++I) {
+    bool Satisfied = isSatisfied(Affinities[I]);
+    if (WasSatisfied[I] == Satisfied)
+      continue;
+    if (Satisfied) {
+      ++NumRemoved;
+      Freq += Affinities[I].Weight;
+    } else {
+      ++NumAdded;
+      Freq -= Affinities[I].Weight;
+    }
+  }
+  NumRecolored += NumRemoved;
+  NumBroken += NumAdded;
+  return {NumRemoved, NumAdded, Freq};
+}
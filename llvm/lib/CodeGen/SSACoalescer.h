@@ -0,0 +1,115 @@
+//===- SSACoalescer.h - Affinity recoloring for SSA allocation --*- C++ -*-===//
+//
+// Part of the LLVM Project, under the Apache License v2.0 with LLVM Exceptions.
+// See https://llvm.org/LICENSE.txt for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+//
+//===----------------------------------------------------------------------===//
+//
+// The SSACoalescer runs after the SSA register allocator has colored every
+// live range. It removes copies by recoloring: the two sides of a copy are
+// affine, and when both receive the same register the copy becomes an
+// identity copy that VirtRegRewriter deletes.
+//
+// Live ranges are never merged, so the interference graph, and with it the
+// guarantee that the coloring fits in the available registers, is unchanged.
+// Affine live ranges that don't interfere are grouped into chunks, and each
+// chunk is recolored as a unit, heaviest first, following Hack and Goos, "Copy
+// Coalescing by Graph Recoloring". Copies are weighted by the frequency of
+// their block.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef LLVM_LIB_CODEGEN_SSACOALESCER_H
+#define LLVM_LIB_CODEGEN_SSACOALESCER_H
+
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/DenseSet.h"
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/CodeGen/PackedLiveRange.h"
+#include "llvm/CodeGen/Register.h"
+#include "llvm/MC/MCRegister.h"
+#include <functional>
+#include <tuple>
+
+namespace llvm {
+
+class LiveInterval;
+class LiveIntervals;
+class LiveRegMatrix;
+class MachineBlockFrequencyInfo;
+class MachineFunction;
+class RegisterClassInfo;
+class TargetRegisterInfo;
+class VirtRegMap;
+
+class LLVM_LIBRARY_VISIBILITY SSACoalescer {
+  MachineFunction &MF;
+  LiveIntervals &LIS;
+  VirtRegMap &VRM;
+  LiveRegMatrix &Matrix;
+  const MachineBlockFrequencyInfo &MBFI;
+  const RegisterClassInfo &RegClassInfo;
+  const TargetRegisterInfo &TRI;
+
+  /// Registers colored by this allocator, which may be recolored.
+  std::function<bool(Register)> ShouldAllocate;
+
+  /// A copy between two virtual registers, or between a virtual register and
+  /// a fixed register in B.
+  struct Affinity {
+    Register A;
+    Register B;
+    double Weight;
+  };
+  SmallVector<Affinity, 32> Affinities;
+  DenseMap<Register, SmallVector<unsigned, 4>> AffinitiesOf;
+
+  /// Groups of affine, non-interfering virtual registers.
+  struct Chunk {
+    SmallVector<Register, 4> Regs;
+    double Weight = 0;
+  };
+  SmallVector<Chunk, 16> Chunks;
+  DenseMap<Register, unsigned> ChunkOf;
+
+  /// Copies of the live ranges that chunks are built from, for the repeated
+  /// interference checks between the members of two chunks.
+  DenseMap<Register, PackedLiveRange> Packed;
+
+  /// Registers whose color was fixed by an earlier chunk.
+  DenseSet<Register> Locked;
+
+  /// Undo log of the assignments changed while trying a color.
+  SmallVector<std::pair<Register, MCRegister>, 16> Changes;
+
+  bool isRecolorable(Register Reg) const;
+  MCRegister getColor(Register Reg) const;
+  bool isSatisfied(const Affinity &Aff) const;
+  void collectAffinities();
+  void buildChunks();
+  bool interferes(const Chunk &A, const Chunk &B) const;
+
+  void reassign(const LiveInterval &LI, MCRegister PhysReg);
+  bool moveAside(const LiveInterval &LI, MCRegister PhysReg,
+                 const Chunk &Owner);
+  void tryColor(const Chunk &C, MCRegister PhysReg);
+  void undo(unsigned Mark);
+  double getGain(unsigned Mark) const;
+  void recolor(const Chunk &C);
+
+public:
+  SSACoalescer(MachineFunction &MF, LiveIntervals &LIS, VirtRegMap &VRM,
+               LiveRegMatrix &Matrix, const MachineBlockFrequencyInfo &MBFI,
+               const RegisterClassInfo &RegClassInfo,
+               std::function<bool(Register)> ShouldAllocate);
+
+  /// Recolor the function. Return the number of copies that became identity
+  /// copies, the number of identity copies that became real copies again, and
+  /// the net change of the copy frequency relative to the function entry.
+  std::tuple<unsigned, unsigned, double> run();
+};
+
+} // end namespace llvm
+
+#endif // LLVM_LIB_CODEGEN_SSACOALESCER_H
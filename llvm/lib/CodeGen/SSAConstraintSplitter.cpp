@@ -0,0 +1,244 @@
+//===- SSAConstraintSplitter.cpp - Splitting at fixed registers -----------===//
+//
+// Part of the LLVM Project, under the Apache License v2.0 with LLVM Exceptions.
+// See https://llvm.org/LICENSE.txt for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+//
+//===----------------------------------------------------------------------===//
+//
+// Every live range is split with one SplitEditor pass, opening an interval
+// for each region it crosses. The copies into and out of the region pieces
+// are placed right before and after the region. Once all live ranges are
+// split, the copies next to each region are bundled, and the live intervals
+// of the registers they copy are recomputed with the bundle as a single
+// instruction.
+//
+//===----------------------------------------------------------------------===//
+
+#include "SSAConstraintSplitter.h"
+#include "llvm/ADT/STLExtras.h"
+#include "llvm/ADT/Statistic.h"
+#include "llvm/CodeGen/CalcSpillWeights.h"
+#include "llvm/CodeGen/LiveDebugVariables.h"
+#include "llvm/CodeGen/LiveInterval.h"
+#include "llvm/CodeGen/LiveIntervals.h"
+#include "llvm/CodeGen/LiveRangeEdit.h"
+#include "llvm/CodeGen/MachineFunction.h"
+#include "llvm/CodeGen/MachineInstr.h"
+#include "llvm/CodeGen/MachineRegisterInfo.h"
+#include "llvm/CodeGen/RegisterClassInfo.h"
+#include "llvm/CodeGen/TargetRegisterInfo.h"
+#include "llvm/CodeGen/TargetSubtargetInfo.h"
+#include "llvm/CodeGen/VirtRegMap.h"
+#include "llvm/MC/MCRegisterInfo.h"
+#include "llvm/Support/Debug.h"
+#include "llvm/Support/raw_ostream.h"
+
+using namespace llvm;
+
+#define DEBUG_TYPE "regalloc"
+
+STATISTIC(NumConstraintSplits,
+          "Number of live ranges split around constrained instructions");
+STATISTIC(NumParallelCopies,
+          "Number of copies bundled into parallel copies at constraints");
+
+SSAConstraintSplitter::SSAConstraintSplitter(
+    MachineFunction &MF, LiveIntervals &LIS, VirtRegMap &VRM,
+    const MachineLoopInfo &Loops, MachineDominatorTree &MDT,
+    MachineBlockFrequencyInfo &MBFI, VirtRegAuxInfo &VRAI,
+    LiveDebugVariables &DebugVars, const RegisterClassInfo &RegClassInfo,
+    std::function<bool(Register)> ShouldAllocate)
+    : MF(MF), LIS(LIS), VRM(VRM), DebugVars(DebugVars), VRAI(VRAI),
+      RegClassInfo(RegClassInfo), MRI(MF.getRegInfo()),
+      TRI(*MF.getSubtarget().getRegisterInfo()), SA(VRM, LIS, Loops),
+      SE(SA, LIS, VRM, MDT, MBFI, VRAI),
+      ShouldAllocate(std::move(ShouldAllocate)) {}
+
+bool SSAConstraintSplitter::isConstrained(const MachineInstr &MI) const {
+  if (MI.isDebugInstr() || MI.isTerminator())
+    return false;
+  return any_of(MI.operands(), [&](const MachineOperand &MO) {
+    return MO.isRegMask() || (MO.isReg() && MO.getReg().isPhysical() &&
+                              MRI.isAllocatable(MO.getReg()));
+  });
+}
+
+void SSAConstraintSplitter::collectRegions() {
+  for (MachineBasicBlock &MBB : MF) {
+    Region *Open = nullptr;
+    for (MachineInstr &MI : MBB) {
+      if (MI.isDebugInstr())
+        continue;
+      if (!isConstrained(MI)) {
+        Open = nullptr;
+        continue;
+      }
+      if (!Open) {
+        Open = &Regions.emplace_back();
+        Open->First = &MI;
+        Open->Blocked.resize(TRI.getNumRegs());
+      }
+      Open->Last = &MI;
+      for (const MachineOperand &MO : MI.operands()) {
+        if (MO.isRegMask())
+          Open->Blocked.setBitsNotInMask(MO.getRegMask());
+        else if (MO.isReg() && MO.getReg().isPhysical())
+          for (MCRegAliasIterator AI(MO.getReg(), &TRI, true); AI.isValid();
+               ++AI)
+            Open->Blocked.set(*AI);
+      }
+    }
+  }
+}
+
+bool SSAConstraintSplitter::isBlocked(const Region &R,
+                                      const TargetRegisterClass &RC) const {
+  return any_of(RegClassInfo.getOrder(&RC),
+                [&](MCPhysReg PhysReg) { return R.Blocked.test(PhysReg); });
+}
+
+void SSAConstraintSplitter::splitRange(const LiveInterval &LI,
+                                       ArrayRef<unsigned> Through) {
+  SA.analyze(&LI);
+  // The copy out of a region must go before the block's terminators.
+  SmallVector<unsigned, 4> Split;
+  for (unsigned Idx : Through) {
+    const Region &R = Regions[Idx];
+    if (LIS.getInstructionIndex(*R.Last) <
+        SA.getLastSplitPoint(R.Last->getParent()))
+      Split.push_back(Idx);
+  }
+  if (Split.empty())
+    return;
+
+  Register Reg = LI.reg();
+  SmallVector<Register, 4> NewRegs;
+  LiveRangeEdit LRE(&LI, NewRegs, MF, LIS, &VRM);
+  SE.reset(LRE);
+  for (unsigned Idx : Split) {
+    const Region &R = Regions[Idx];
+    SE.openIntv();
+    SlotIndex Start = SE.enterIntvBefore(LIS.getInstructionIndex(*R.First));
+    SlotIndex Stop = SE.leaveIntvAfter(LIS.getInstructionIndex(*R.Last));
+    SE.useIntv(Start, Stop);
+  }
+  SmallVector<unsigned, 8> IntvMap;
+  SE.finish(&IntvMap);
+  DebugVars.splitRegister(Reg, LRE.regs(), LIS);
+
+  // Interval 0 is the complement, the others were opened in Split order.
+  for (unsigned I = 0, E = LRE.size(); I != E; ++I)
+    if (IntvMap[I])
+      RegionOf[LRE.get(I)] = Split[IntvMap[I] - 1];
+  LLVM_DEBUG(dbgs() << "Split " << printReg(Reg, &TRI) << " around "
+                    << Split.size() << " constrained regions\n");
+  NumSplits += Split.size();
+}
+
+void SSAConstraintSplitter::bundleCopies(ArrayRef<MachineInstr *> Copies) {
+  SmallVector<Register, 8> Regs;
+  for (MachineInstr *MI : Copies) {
+    Regs.push_back(MI->getOperand(0).getReg());
+    Regs.push_back(MI->getOperand(1).getReg());
+  }
+  llvm::sort(Regs);
+  Regs.erase(llvm::unique(Regs), Regs.end());
+  for (Register Reg : Regs)
+    LIS.removeInterval(Reg);
+
+  // A bundle without a header reads all sources before writing any
+  // destination, and takes the slot index of its first copy.
+  MachineBasicBlock &MBB = *Copies.front()->getParent();
+  for (unsigned I = 1, E = Copies.size(); I != E; ++I) {
+    MachineInstr *MI = Copies[I];
+    LIS.RemoveMachineInstrFromMaps(*MI);
+    MBB.splice(std::next(Copies[I - 1]->getIterator()), &MBB, MI);
+    MI->bundleWithPred();
+  }
+
+  for (Register Reg : Regs)
+    VRAI.calculateSpillWeightAndHint(LIS.createAndComputeVirtRegInterval(Reg));
+  NumBundled += Copies.size();
+}
+
+void SSAConstraintSplitter::bundleRegion(unsigned Idx) {
+  const Region &R = Regions[Idx];
+  auto IsRegionCopy = [&](const MachineInstr &MI, unsigned OpNo) {
+    if (!MI.isCopy() || MI.getOperand(0).getSubReg() ||
+        MI.getOperand(1).getSubReg())
+      return false;
+    auto It = RegionOf.find(MI.getOperand(OpNo).getReg());
+    return It != RegionOf.end() && It->second == Idx;
+  };
+
+  // The copies into the region pieces define them right before the region.
+  SmallVector<MachineInstr *, 8> Copies;
+  MachineBasicBlock &MBB = *R.First->getParent();
+  for (auto I = R.First->getIterator(); I != MBB.instr_begin();) {
+    MachineInstr &MI = *--I;
+    if (MI.isDebugInstr())
+      continue;
+    if (!IsRegionCopy(MI, 0))
+      break;
+    Copies.push_back(&MI);
+  }
+  std::reverse(Copies.begin(), Copies.end());
+  if (Copies.size() > 1)
+    bundleCopies(Copies);
+
+  // The copies out of them follow the region.
+  Copies.clear();
+  for (auto I = std::next(R.Last->getIterator()); I != MBB.instr_end();
+       ++I) {
+    if (I->isDebugInstr())
+      continue;
+    if (!IsRegionCopy(*I, 1))
+      break;
+    Copies.push_back(&*I);
+  }
+  if (Copies.size() > 1)
+    bundleCopies(Copies);
+}
+
+std::pair<unsigned, unsigned> SSAConstraintSplitter::run() {
+  collectRegions();
+  if (Regions.empty())
+    return {0, 0};
+
+  // Only the original live ranges are split, never the pieces.
+  SmallVector<Register, 64> Candidates;
+  for (unsigned I = 0, E = MRI.getNumVirtRegs(); I != E; ++I) {
+    Register Reg = Register::index2VirtReg(I);
+    if (!MRI.reg_nodbg_empty(Reg) && ShouldAllocate(Reg) &&
+        LIS.hasInterval(Reg) && !LIS.getInterval(Reg).empty())
+      Candidates.push_back(Reg);
+  }
+
+  for (Register Reg : Candidates) {
+    const LiveInterval &LI = LIS.getInterval(Reg);
+    const TargetRegisterClass &RC = *MRI.getRegClass(Reg);
+    SmallVector<unsigned, 4> Through;
+    for (const LiveRange::Segment &S : LI) {
+      // The first region that starts inside the segment. Slot indexes of
+      // existing instructions stay ordered as copies are inserted.
+      const Region *I = partition_point(Regions, [&](const Region &R) {
+        return LIS.getInstructionIndex(*R.First) < S.start;
+      });
+      for (; I != Regions.end() &&
+             LIS.getInstructionIndex(*I->Last).getDeadSlot() < S.end;
+           ++I)
+        if (isBlocked(*I, RC))
+          Through.push_back(I - Regions.begin());
+    }
+    if (!Through.empty())
+      splitRange(LI, Through);
+  }
+
+  for (unsigned Idx = 0, E = Regions.size(); Idx != E; ++Idx)
+    bundleRegion(Idx);
+
+  NumConstraintSplits += NumSplits;
+  NumParallelCopies += NumBundled;
+  return {NumSplits, NumBundled};
+}
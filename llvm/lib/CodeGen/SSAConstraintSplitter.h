@@ -0,0 +1,112 @@
+//===- SSAConstraintSplitter.h - Splitting at fixed registers ---*- C++ -*-===//
+//
+// Part of the LLVM Project, under the Apache License v2.0 with LLVM Exceptions.
+// See https://llvm.org/LICENSE.txt for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+//
+//===----------------------------------------------------------------------===//
+//
+// The SSAConstraintSplitter runs before the SSA register allocator colors
+// anything. Instructions that read or write fixed registers, like calls, the
+// copies of ABI arguments and return values, and inline asm, take registers
+// away from the values that are live across them. A live range that crosses
+// such an instruction has to avoid those registers over its whole length,
+// which breaks the chordal coloring guarantee.
+//
+// Each run of consecutive constrained instructions in a block is a region.
+// Every live range that is live through a region and whose class loses a
+// register there is split into a piece around the region and pieces outside
+// of it, so only the piece around the region sees the constraint. The copies
+// entering and leaving a region are bundled, and act as one parallel copy
+// that VirtRegRewriter lowers after assignment, with swaps if needed. The
+// SSACoalescer later recolors the pieces to remove the copies where possible.
+//
+// Tied operands need no splitting: two-address lowering already copied the
+// tied use into the def register, which is then a single live range.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef LLVM_LIB_CODEGEN_SSACONSTRAINTSPLITTER_H
+#define LLVM_LIB_CODEGEN_SSACONSTRAINTSPLITTER_H
+
+#include "SplitKit.h"
+#include "llvm/ADT/BitVector.h"
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/CodeGen/Register.h"
+#include <functional>
+
+namespace llvm {
+
+class LiveDebugVariables;
+class LiveInterval;
+class LiveIntervals;
+class MachineBlockFrequencyInfo;
+class MachineDominatorTree;
+class MachineFunction;
+class MachineInstr;
+class MachineLoopInfo;
+class MachineRegisterInfo;
+class RegisterClassInfo;
+class TargetRegisterClass;
+class TargetRegisterInfo;
+class VirtRegAuxInfo;
+class VirtRegMap;
+
+class LLVM_LIBRARY_VISIBILITY SSAConstraintSplitter {
+  MachineFunction &MF;
+  LiveIntervals &LIS;
+  VirtRegMap &VRM;
+  LiveDebugVariables &DebugVars;
+  VirtRegAuxInfo &VRAI;
+  const RegisterClassInfo &RegClassInfo;
+  MachineRegisterInfo &MRI;
+  const TargetRegisterInfo &TRI;
+  SplitAnalysis SA;
+  SplitEditor SE;
+
+  /// Registers that are not handled by this allocator.
+  std::function<bool(Register)> ShouldAllocate;
+
+  /// Consecutive constrained instructions of one block.
+  struct Region {
+    MachineInstr *First;
+    MachineInstr *Last;
+    /// Registers read, written or clobbered in the region.
+    BitVector Blocked;
+  };
+  /// Regions in layout order, which is also slot index order.
+  SmallVector<Region, 16> Regions;
+
+  /// The region each new live range was opened for, for the pieces that
+  /// cover a region.
+  DenseMap<Register, unsigned> RegionOf;
+
+  unsigned NumSplits = 0;
+  unsigned NumBundled = 0;
+
+  bool isConstrained(const MachineInstr &MI) const;
+  void collectRegions();
+  bool isBlocked(const Region &R, const TargetRegisterClass &RC) const;
+  void splitRange(const LiveInterval &LI, ArrayRef<unsigned> Through);
+  void bundleCopies(ArrayRef<MachineInstr *> Copies);
+  void bundleRegion(unsigned Idx);
+
+public:
+  SSAConstraintSplitter(MachineFunction &MF, LiveIntervals &LIS,
+                        VirtRegMap &VRM, const MachineLoopInfo &Loops,
+                        MachineDominatorTree &MDT,
+                        MachineBlockFrequencyInfo &MBFI, VirtRegAuxInfo &VRAI,
+                        LiveDebugVariables &DebugVars,
+                        const RegisterClassInfo &RegClassInfo,
+                        std::function<bool(Register)> ShouldAllocate);
+
+  /// Split the live ranges around the constrained regions. Return the number
+  /// of regions crossed by a split live range, and the number of copies that
+  /// were bundled into parallel copies.
+  std::pair<unsigned, unsigned> run();
+};
+
+} // end namespace llvm
+
+#endif // LLVM_LIB_CODEGEN_SSACONSTRAINTSPLITTER_H
@@ -0,0 +1,258 @@
+//===- SSALiveness.cpp - Liveness checks in SSA form ----------------------===//
+//
+// Part of the LLVM Project, under the Apache License v2.0 with LLVM Exceptions.
+// See https://llvm.org/LICENSE.txt for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+//
+//===----------------------------------------------------------------------===//
+//
+// R_q is computed in postorder of the depth-first search, where the successors
+// across the remaining edges are already done. T_q starts with q and the
+// targets of the back edges leaving R_q, and is closed under T_t for every
+// target t, which also covers irreducible control flow.
+//
+//===----------------------------------------------------------------------===//
+
+#include "llvm/CodeGen/SSALiveness.h"
+#include "llvm/ADT/DepthFirstIterator.h"
+#include "llvm/ADT/STLExtras.h"
+#include "llvm/CodeGen/MachineDominators.h"
+#include "llvm/CodeGen/MachineRegisterInfo.h"
+#include "llvm/InitializePasses.h"
+#include "llvm/Support/raw_ostream.h"
+
+using namespace llvm;
+
+#define DEBUG_TYPE "ssa-liveness"
+
+void SSALiveness::compute(const MachineFunction &MF,
+                          const MachineDominatorTree &MDT) {
+  releaseMemory();
+  this->MF = &MF;
+  MRI = &MF.getRegInfo();
+  unsigned NumBlocks = MF.getNumBlockIDs();
+
+  // Number the dominator tree in preorder. A subtree spans the numbers from
+  // its root to the root plus the subtree size.
+  DomRange.assign(NumBlocks, {~0u, ~0u});
+  SmallVector<const MachineDomTreeNode *, 32> Preorder(
+      depth_first(MDT.getRootNode()));
+  for (unsigned I = 0, E = Preorder.size(); I != E; ++I)
+    DomRange[Preorder[I]->getBlock()->getNumber()].first = I;
+  SmallVector<unsigned, 32> SubtreeSize(Preorder.size(), 1);
+  for (unsigned I = Preorder.size(); I-- != 0;) {
+    const MachineDomTreeNode *Node = Preorder[I];
+    DomRange[Node->getBlock()->getNumber()].second = I + SubtreeSize[I] - 1;
+    if (const MachineDomTreeNode *IDom = Node->getIDom())
+      SubtreeSize[DomRange[IDom->getBlock()->getNumber()].first] +=
+          SubtreeSize[I];
+  }
+
+  // Depth-first search over the CFG. An edge to a block that is still on the
+  // stack is a back edge.
+  Reachable.assign(NumBlocks, BitVector());
+  SmallVector<SmallVector<unsigned, 2>, 0> BackTargets(NumBlocks);
+  SmallVector<unsigned, 32> Postorder;
+  BitVector Visited(NumBlocks), OnStack(NumBlocks);
+  using StackEntry =
+      std::pair<const MachineBasicBlock *,
+                MachineBasicBlock::const_succ_iterator>;
+  SmallVector<StackEntry, 32> Stack;
+  const MachineBasicBlock *Entry = &MF.front();
+  Visited.set(Entry->getNumber());
+  OnStack.set(Entry->getNumber());
+  Stack.push_back({Entry, Entry->succ_begin()});
+  while (!Stack.empty()) {
+    auto &[MBB, SuccI] = Stack.back();
+    if (SuccI == MBB->succ_end()) {
+      unsigned Num = MBB->getNumber();
+      OnStack.reset(Num);
+      Postorder.push_back(Num);
+      Stack.pop_back();
+      continue;
+    }
+    const MachineBasicBlock *Succ = *SuccI++;
+    unsigned SuccNum = Succ->getNumber();
+    if (OnStack.test(SuccNum)) {
+      BackTargets[MBB->getNumber()].push_back(SuccNum);
+    } else if (!Visited.test(SuccNum)) {
+      Visited.set(SuccNum);
+      OnStack.set(SuccNum);
+      Stack.push_back({Succ, Succ->succ_begin()});
+    }
+  }
+
+  // Successors across forward, tree and cross edges finish first.
+  BitVector Done(NumBlocks);
+  for (unsigned Num : Postorder) {
+    BitVector &R = Reachable[Num];
+    R.resize(NumBlocks);
+    R.set(Num);
+    for (const MachineBasicBlock *Succ :
+         MF.getBlockNumbered(Num)->successors())
+      if (Done.test(Succ->getNumber()))
+        R |= Reachable[Succ->getNumber()];
+    Done.set(Num);
+  }
+
+  SmallVector<BitVector, 0> T(NumBlocks);
+  for (unsigned Num : Postorder) {
+    const BitVector &R = Reachable[Num];
+    T[Num].resize(NumBlocks);
+    T[Num].set(Num);
+    for (unsigned S : R.set_bits())
+      for (unsigned Target : BackTargets[S])
+        if (!R.test(Target))
+          T[Num].set(Target);
+  }
+  for (bool Changed = true; Changed;) {
+    Changed = false;
+    for (unsigned Num : Postorder) {
+      BitVector Closure = T[Num];
+      for (unsigned Target : T[Num].set_bits())
+        if (Target != Num)
+          Closure |= T[Target];
+      if (Closure != T[Num]) {
+        T[Num] = std::move(Closure);
+        Changed = true;
+      }
+    }
+  }
+
+  Targets.resize(NumBlocks);
+  for (unsigned Num : Postorder) {
+    SmallVectorImpl<unsigned> &Ts = Targets[Num];
+    append_range(Ts, T[Num].set_bits());
+    llvm::sort(Ts, [&](unsigned A, unsigned B) {
+      return DomRange[A].first < DomRange[B].first;
+    });
+  }
+}
+
+/// Return the block where \p MO reads its register. A PHI operand is read at
+/// the end of its incoming block.
+static const MachineBasicBlock *getUseBlock(const MachineOperand &MO) {
+  const MachineInstr &UseMI = *MO.getParent();
+  if (UseMI.isPHI())
+    return UseMI.getOperand(MO.getOperandNo() + 1).getMBB();
+  return UseMI.getParent();
+}
+
+bool SSALiveness::isLiveIn(Register Reg, const MachineBasicBlock &MBB) const {
+  const MachineInstr *Def = MRI->getVRegDef(Reg);
+  if (!Def)
+    return false;
+  unsigned D = Def->getParent()->getNumber();
+  if (!properlyDominates(D, MBB.getNumber()))
+    return false;
+
+  // The targets that D strictly dominates are contiguous in preorder.
+  ArrayRef<unsigned> Ts = Targets[MBB.getNumber()];
+  auto I = partition_point(Ts, [&](unsigned T) {
+    return DomRange[T].first <= DomRange[D].first;
+  });
+  for (; I != Ts.end() && DomRange[*I].first <= DomRange[D].second; ++I)
+    for (const MachineOperand &MO : MRI->use_nodbg_operands(Reg))
+      if (Reachable[*I].test(getUseBlock(MO)->getNumber()))
+        return true;
+  return false;
+}
+
+bool SSALiveness::isLiveOut(Register Reg, const MachineBasicBlock &MBB) const {
+  const MachineInstr *Def = MRI->getVRegDef(Reg);
+  if (!Def || DomRange[MBB.getNumber()].first == ~0u)
+    return false;
+
+  // Every use outside the defining block is reached through its end.
+  if (Def->getParent() == &MBB)
+    return any_of(MRI->use_nodbg_operands(Reg), [&](const MachineOperand &MO) {
+      return MO.getParent()->isPHI() || MO.getParent()->getParent() != &MBB;
+    });
+
+  if (!properlyDominates(Def->getParent()->getNumber(), MBB.getNumber()))
+    return false;
+  for (const MachineOperand &MO : MRI->use_nodbg_operands(Reg))
+    if (MO.getParent()->isPHI() && getUseBlock(MO) == &MBB)
+      return true;
+  return any_of(MBB.successors(), [&](const MachineBasicBlock *Succ) {
+    return isLiveIn(Reg, *Succ);
+  });
+}
+
+void SSALiveness::releaseMemory() {
+  MF = nullptr;
+  MRI = nullptr;
+  DomRange.clear();
+  Reachable.clear();
+  Targets.clear();
+}
+
+void SSALiveness::print(raw_ostream &OS) const {
+  if (!MF)
+    return;
+  OS << "SSA liveness for machine function: " << MF->getName() << '\n';
+  const TargetRegisterInfo *TRI = MRI->getTargetRegisterInfo();
+  auto PrintLive = [&](StringRef Name, const MachineBasicBlock &MBB,
+                       auto IsLive) {
+    OS << ' ' << Name << ':';
+    for (unsigned I = 0, E = MRI->getNumVirtRegs(); I != E; ++I) {
+      Register Reg = Register::index2VirtReg(I);
+      if (MRI->hasOneDef(Reg) && IsLive(Reg, MBB))
+        OS << ' ' << printReg(Reg, TRI);
+    }
+    OS << ';';
+  };
+  for (const MachineBasicBlock &MBB : *MF) {
+    OS << "  " << printMBBReference(MBB) << ':';
+    PrintLive("live-in", MBB, [&](Register Reg, const MachineBasicBlock &B) {
+      return isLiveIn(Reg, B);
+    });
+    PrintLive("live-out", MBB, [&](Register Reg, const MachineBasicBlock &B) {
+      return isLiveOut(Reg, B);
+    });
+    OS << '\n';
+  }
+}
+
+char SSALivenessWrapperPass::ID = 0;
+
+INITIALIZE_PASS_BEGIN(SSALivenessWrapperPass, DEBUG_TYPE,
+                      "SSA Liveness Check Analysis", false, true)
+INITIALIZE_PASS_DEPENDENCY(MachineDominatorTreeWrapperPass)
+INITIALIZE_PASS_END(SSALivenessWrapperPass, DEBUG_TYPE,
+                    "SSA Liveness Check Analysis", false, true)
+
+SSALivenessWrapperPass::SSALivenessWrapperPass() : MachineFunctionPass(ID) {
+  initializeSSALivenessWrapperPassPass(*PassRegistry::getPassRegistry());
+}
+
+void SSALivenessWrapperPass::getAnalysisUsage(AnalysisUsage &AU) const {
+  AU.setPreservesAll();
+  AU.addRequired<MachineDominatorTreeWrapperPass>();
+  MachineFunctionPass::getAnalysisUsage(AU);
+}
+
+bool SSALivenessWrapperPass::runOnMachineFunction(MachineFunction &MF) {
+  SL.compute(MF, getAnalysis<MachineDominatorTreeWrapperPass>().getDomTree());
+  return false;
+}
+
+void SSALivenessWrapperPass::print(raw_ostream &OS, const Module *) const {
+  SL.print(OS);
+}
+
+AnalysisKey SSALivenessAnalysis::Key;
+
+SSALiveness SSALivenessAnalysis::run(MachineFunction &MF,
+                                     MachineFunctionAnalysisManager &MFAM) {
+  SSALiveness SL;
+  SL.compute(MF, MFAM.getResult<MachineDominatorTreeAnalysis>(MF));
+  return SL;
+}
+
+PreservedAnalyses
+SSALivenessPrinterPass::run(MachineFunction &MF,
+                            MachineFunctionAnalysisManager &MFAM) {
+  MFAM.getResult<SSALivenessAnalysis>(MF).print(OS);
+  return PreservedAnalyses::all();
+}
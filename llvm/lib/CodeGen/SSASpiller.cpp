@@ -0,0 +1,673 @@
+//===- SSASpiller.cpp - Belady spilling for the SSA allocator -------------===//
+//
+// Part of the LLVM Project, under the Apache License v2.0 with LLVM Exceptions.
+// See https://llvm.org/LICENSE.txt for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+//
+//===----------------------------------------------------------------------===//
+//
+// This file implements the spilling stage of the SSA register allocator. The
+// algorithm follows Braun and Hack, "Register Spilling and Live-Range
+// Splitting for SSA-Form Programs":
+//
+//  1. Compute the distance from each block entry to the next use of every
+//     live-in value. This is a backward data-flow problem over the CFG where
+//     edges leaving a loop get a large length.
+//  2. Walk the blocks in reverse post-order and simulate the register file.
+//     Before an instruction, reload the used values that are not in registers.
+//     Whenever a pressure set is over its limit, evict the value with the
+//     furthest next use. Around calls, only the registers preserved by the
+//     call are available to the values that live across it.
+//  3. Reload on the CFG edges where a value is expected in a register at the
+//     successor entry but not available at the predecessor exit. A single
+//     reload at the successor entry replaces them when the block frequencies
+//     say it is cheaper, when an edge is critical, or when the value doesn't
+//     fit next to the values live at the end of a predecessor.
+//
+// Reloads write the original virtual register. Its live interval is then
+// recomputed and split into connected components, so every reload that is not
+// joined with other definitions of the value gets a virtual register of its
+// own, and the pieces can be colored independently. Every definition of a
+// reloaded value is followed by a store to its stack slot. A rematerialized
+// value gets a copy of its definition instead of the reload, and no store; the
+// original definition is deleted when all the uses read a copy.
+//
+//===----------------------------------------------------------------------===//
+
+#include "SSASpiller.h"
+#include "SplitKit.h"
+#include "llvm/ADT/PostOrderIterator.h"
+#include "llvm/ADT/STLExtras.h"
+#include "llvm/ADT/SmallPtrSet.h"
+#include "llvm/ADT/Statistic.h"
+#include "llvm/CodeGen/LiveIntervals.h"
+#include "llvm/CodeGen/LiveStacks.h"
+#include "llvm/CodeGen/MachineBlockFrequencyInfo.h"
+#include "llvm/CodeGen/MachineFunction.h"
+#include "llvm/CodeGen/MachineInstr.h"
+#include "llvm/CodeGen/MachineLoopInfo.h"
+#include "llvm/CodeGen/MachineOperand.h"
+#include "llvm/CodeGen/MachineRegisterInfo.h"
+#include "llvm/CodeGen/ParallelCopy.h"
+#include "llvm/CodeGen/RegisterClassInfo.h"
+#include "llvm/CodeGen/TargetInstrInfo.h"
+#include "llvm/CodeGen/TargetRegisterInfo.h"
+#include "llvm/CodeGen/TargetSubtargetInfo.h"
+#include "llvm/CodeGen/VirtRegMap.h"
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/Debug.h"
+#include "llvm/Support/raw_ostream.h"
+#include <limits>
+
+using namespace llvm;
+
+#define DEBUG_TYPE "regalloc"
+
+STATISTIC(NumSpills, "Number of spills inserted before SSA coloring");
+STATISTIC(NumReloads, "Number of reloads inserted before SSA coloring");
+STATISTIC(NumRemats, "Number of values rematerialized before SSA coloring");
+STATISTIC(NumEvictions, "Number of values evicted by the SSA spiller");
+STATISTIC(NumComponents,
+          "Number of reloaded pieces renamed by the SSA spiller");
+
+static cl::opt<unsigned> LoopExitDistance(
+    "ssa-spill-loop-exit-distance", cl::Hidden, cl::init(1 << 16),
+    cl::desc("Next-use distance added to CFG edges that leave a loop"));
+
+static cl::opt<unsigned> RematBias(
+    "ssa-spill-remat-bias", cl::Hidden, cl::init(2),
+    cl::desc("Factor applied to the next-use distance of rematerializable "
+             "values when choosing a value to evict (0 or 1 = no bias)"));
+
+static constexpr unsigned Infinity = std::numeric_limits<unsigned>::max();
+
+/// Add two next-use distances, saturating at Infinity.
+static unsigned addDistance(unsigned A, unsigned B) {
+  return A > Infinity - B ? Infinity : A + B;
+}
+
+static const uint32_t *getRegMask(const MachineInstr &MI) {
+  for (const MachineOperand &MO : MI.operands())
+    if (MO.isRegMask())
+      return MO.getRegMask();
+  return nullptr;
+}
+
+SSASpiller::SSASpiller(MachineFunction &MF, LiveIntervals &LIS,
+                       LiveStacks &LSS, VirtRegMap &VRM,
+                       const MachineLoopInfo &Loops,
+                       const MachineBlockFrequencyInfo &MBFI,
+                       const RegisterClassInfo &RegClassInfo,
+                       std::function<bool(Register)> ShouldAllocate)
+    : MF(MF), LIS(LIS), LSS(LSS), VRM(VRM), Loops(Loops), MBFI(MBFI),
+      RegClassInfo(RegClassInfo), MRI(MF.getRegInfo()),
+      TII(*MF.getSubtarget().getInstrInfo()),
+      TRI(*MF.getSubtarget().getRegisterInfo()),
+      ShouldAllocate(std::move(ShouldAllocate)) {}
+
+MachineInstr *SSASpiller::getRematDef(Register Reg,
+                                      const MachineRegisterInfo &MRI,
+                                      const TargetInstrInfo &TII) {
+  MachineInstr *DefMI = MRI.getUniqueVRegDef(Reg);
+  if (!DefMI || !TII.isReMaterializable(*DefMI))
+    return nullptr;
+  // The copy must write the whole register, and must not depend on values
+  // that may be gone at the point of use.
+  for (const MachineOperand &MO : DefMI->operands()) {
+    if (!MO.isReg() || !MO.getReg())
+      continue;
+    if (MO.isDef()) {
+      if (MO.getReg() != Reg || MO.getSubReg())
+        return nullptr;
+    } else if (MO.getReg().isVirtual() ||
+               (MO.readsReg() && !MRI.isConstantPhysReg(MO.getReg()))) {
+      return nullptr;
+    }
+  }
+  return DefMI;
+}
+
+void SSASpiller::analyzeRegisters() {
+  unsigned NumVirtRegs = MRI.getNumVirtRegs();
+  Counted.assign(NumVirtRegs, false);
+  Evictable.assign(NumVirtRegs, false);
+  RematDefs.assign(NumVirtRegs, nullptr);
+  for (unsigned I = 0; I != NumVirtRegs; ++I) {
+    Register Reg = Register::index2VirtReg(I);
+    if (MRI.reg_nodbg_empty(Reg) || VRM.hasPhys(Reg) || !ShouldAllocate(Reg))
+      continue;
+    const TargetRegisterClass *RC = MRI.getRegClass(Reg);
+    if (!RC->isAllocatable() || !LIS.hasInterval(Reg))
+      continue;
+    Counted[I] = true;
+
+    const LiveInterval &LI = LIS.getInterval(Reg);
+    if (LI.empty() || !LI.isSpillable() || RC->expensiveOrImpossibleToCopy())
+      continue;
+    // Stores are inserted after every def and reloads before uses, which is
+    // impossible inside bundles and after terminators.
+    Evictable[I] = llvm::none_of(
+        MRI.reg_nodbg_instructions(Reg), [&](const MachineInstr &MI) {
+          return MI.isBundled() || (MI.isTerminator() && MI.modifiesRegister(
+                                                             Reg, &TRI));
+        });
+    if (Evictable[I])
+      RematDefs[I] = getRematDef(Reg, MRI, TII);
+  }
+}
+
+void SSASpiller::computeLimits() {
+  unsigned NumPSets = TRI.getNumRegPressureSets();
+  Limits.resize(NumPSets);
+  for (unsigned PSet = 0; PSet != NumPSets; ++PSet)
+    Limits[PSet] = RegClassInfo.getRegPressureSetLimit(PSet);
+  Pressure.assign(NumPSets, 0);
+  CallLimits.clear();
+}
+
+// Scale the limit of each pressure set by the fraction of its allocatable
+// registers that survive the call.
+ArrayRef<unsigned> SSASpiller::getCallLimits(const uint32_t *RegMask) {
+  auto [It, Inserted] = CallLimits.try_emplace(RegMask);
+  SmallVectorImpl<unsigned> &CallLimit = It->second;
+  if (!Inserted)
+    return CallLimit;
+
+  unsigned NumPSets = Limits.size();
+  SmallVector<unsigned, 8> Total(NumPSets), Preserved(NumPSets);
+  for (unsigned PhysReg = 1, E = TRI.getNumRegs(); PhysReg != E; ++PhysReg) {
+    if (!MRI.isAllocatable(PhysReg))
+      continue;
+    bool Clobbered = MachineOperand::clobbersPhysReg(RegMask, PhysReg);
+    MCRegUnit Unit = *TRI.regunits(PhysReg).begin();
+    for (const int *PSet = TRI.getRegUnitPressureSets(Unit); *PSet != -1;
+         ++PSet) {
+      ++Total[*PSet];
+      if (!Clobbered)
+        ++Preserved[*PSet];
+    }
+  }
+
+  CallLimit.resize(NumPSets);
+  for (unsigned PSet = 0; PSet != NumPSets; ++PSet)
+    CallLimit[PSet] = Total[PSet]
+                          ? Limits[PSet] * Preserved[PSet] / Total[PSet]
+                          : Limits[PSet];
+  return CallLimit;
+}
+
+unsigned SSASpiller::getExitDistance(const MachineBasicBlock &MBB,
+                                     Register Reg) const {
+  const MachineLoop *Loop = Loops.getLoopFor(&MBB);
+  unsigned Dist = Infinity;
+  for (const MachineBasicBlock *Succ : MBB.successors()) {
+    const BlockInfo &SI = Blocks[Succ->getNumber()];
+    auto It = SI.NextUseIn.find(Reg);
+    if (It == SI.NextUseIn.end())
+      continue;
+    unsigned SuccDist = It->second;
+    if (Loop && !Loop->contains(Succ))
+      SuccDist = addDistance(SuccDist, LoopExitDistance);
+    Dist = std::min(Dist, SuccDist);
+  }
+  return Dist;
+}
+
+void SSASpiller::computeNextUseDistances() {
+  Blocks.clear();
+  Blocks.resize(MF.getNumBlockIDs());
+
+  // A value is live into every block that starts inside one of its segments.
+  const SlotIndexes &Indexes = *LIS.getSlotIndexes();
+  for (unsigned I = 0, E = Counted.size(); I != E; ++I) {
+    if (!Counted[I])
+      continue;
+    Register Reg = Register::index2VirtReg(I);
+    for (const LiveRange::Segment &S : LIS.getInterval(Reg))
+      for (auto MBBI = Indexes.getMBBLowerBound(S.start),
+                MBBE = Indexes.MBBIndexEnd();
+           MBBI != MBBE && MBBI->first < S.end; ++MBBI)
+        Blocks[MBBI->second->getNumber()].LiveIns.push_back(Reg);
+  }
+
+  for (MachineBasicBlock &MBB : MF) {
+    BlockInfo &BI = Blocks[MBB.getNumber()];
+    DenseMap<Register, unsigned> FirstUse;
+    unsigned Pos = 0;
+    for (const MachineInstr &MI : MBB) {
+      if (MI.isDebugInstr())
+        continue;
+      for (const MachineOperand &MO : MI.operands())
+        if (MO.isReg() && MO.readsReg() && isCounted(MO.getReg()))
+          FirstUse.try_emplace(MO.getReg(), Pos);
+      ++Pos;
+    }
+    BI.Length = Pos;
+
+    for (Register Reg : BI.LiveIns) {
+      auto It = FirstUse.find(Reg);
+      if (It != FirstUse.end()) {
+        BI.NextUseIn[Reg] = It->second;
+      } else {
+        BI.NextUseIn[Reg] = Infinity;
+        BI.LiveThrough.push_back(Reg);
+      }
+    }
+  }
+
+  // Shortest paths to the next use. All edge lengths are non-negative, so
+  // iterating in post-order converges quickly.
+  bool Changed = true;
+  while (Changed) {
+    Changed = false;
+    for (MachineBasicBlock *MBB : post_order(&MF)) {
+      BlockInfo &BI = Blocks[MBB->getNumber()];
+      for (Register Reg : BI.LiveThrough) {
+        unsigned Dist = addDistance(BI.Length, getExitDistance(*MBB, Reg));
+        unsigned &Cur = BI.NextUseIn[Reg];
+        if (Dist < Cur) {
+          Cur = Dist;
+          Changed = true;
+        }
+      }
+    }
+  }
+}
+
+void SSASpiller::addPressure(Register Reg) {
+  const TargetRegisterClass *RC = MRI.getRegClass(Reg);
+  unsigned Weight = TRI.getRegClassWeight(RC).RegWeight;
+  for (const int *PSet = TRI.getRegClassPressureSets(RC); *PSet != -1; ++PSet)
+    Pressure[*PSet] += Weight;
+}
+
+void SSASpiller::removePressure(Register Reg) {
+  const TargetRegisterClass *RC = MRI.getRegClass(Reg);
+  unsigned Weight = TRI.getRegClassWeight(RC).RegWeight;
+  for (const int *PSet = TRI.getRegClassPressureSets(RC); *PSet != -1; ++PSet) {
+    assert(Pressure[*PSet] >= Weight && "Register pressure underflow");
+    Pressure[*PSet] -= Weight;
+  }
+}
+
+bool SSASpiller::fits(Register Reg) const {
+  const TargetRegisterClass *RC = MRI.getRegClass(Reg);
+  unsigned Weight = TRI.getRegClassWeight(RC).RegWeight;
+  for (const int *PSet = TRI.getRegClassPressureSets(RC); *PSet != -1; ++PSet)
+    if (Pressure[*PSet] + Weight > Limits[*PSet])
+      return false;
+  return true;
+}
+
+bool SSASpiller::inPressureSet(Register Reg, unsigned PSet) const {
+  for (const int *PS = TRI.getRegClassPressureSets(MRI.getRegClass(Reg));
+       *PS != -1; ++PS)
+    if (unsigned(*PS) == PSet)
+      return true;
+  return false;
+}
+
+void SSASpiller::limit(RegSet &W, ArrayRef<Register> Protected,
+                       ArrayRef<unsigned> Limit,
+                       function_ref<unsigned(Register)> Distance) {
+  for (unsigned PSet = 0, E = Limit.size(); PSet != E; ++PSet) {
+    while (Pressure[PSet] > Limit[PSet]) {
+      Register Victim;
+      unsigned VictimDist = 0;
+      for (Register Reg : W) {
+        if (!Evictable[Reg.virtRegIndex()] || is_contained(Protected, Reg) ||
+            !inPressureSet(Reg, PSet))
+          continue;
+        // A rematerialized value costs no store and no stack slot.
+        unsigned Dist = Distance(Reg);
+        if (RematDefs[Reg.virtRegIndex()] && Dist != Infinity && RematBias > 1)
+          Dist = Dist > Infinity / RematBias ? Infinity - 1 : Dist * RematBias;
+        if (!Victim || Dist > VictimDist) {
+          Victim = Reg;
+          VictimDist = Dist;
+        }
+      }
+      // Only unspillable values are left. The allocator deals with them.
+      if (!Victim)
+        break;
+      LLVM_DEBUG(dbgs() << "  evict " << printReg(Victim, &TRI)
+                        << " next use " << VictimDist << '\n');
+      llvm::erase(W, Victim);
+      removePressure(Victim);
+      ++NumEvictions;
+    }
+  }
+}
+
+void SSASpiller::computeEntrySet(MachineBasicBlock &MBB, RegSet &W) {
+  const BlockInfo &BI = Blocks[MBB.getNumber()];
+  SmallVector<const BlockInfo *, 4> Preds;
+  for (const MachineBasicBlock *Pred : MBB.predecessors())
+    if (Blocks[Pred->getNumber()].Visited)
+      Preds.push_back(&Blocks[Pred->getNumber()]);
+
+  // At a loop header, the back edges are not known yet; prefer the values
+  // used soonest, which are the values used inside the loop. Elsewhere,
+  // prefer the values that are already in registers in every predecessor.
+  bool IsHeader = Loops.isLoopHeader(&MBB) || Preds.empty();
+  struct Candidate {
+    Register Reg;
+    bool Pinned;
+    bool InAllPreds;
+    unsigned Dist;
+  };
+  SmallVector<Candidate, 16> Candidates;
+  for (Register Reg : BI.LiveIns) {
+    bool Pinned = !Evictable[Reg.virtRegIndex()];
+    unsigned NumIn = llvm::count_if(Preds, [&](const BlockInfo *PI) {
+      return is_contained(PI->Exit, Reg);
+    });
+    // A value that is in memory on every incoming path stays there until its
+    // next use.
+    if (!IsHeader && !NumIn && !Pinned)
+      continue;
+    Candidates.push_back({Reg, Pinned, !IsHeader && NumIn == Preds.size(),
+                          BI.NextUseIn.lookup(Reg)});
+  }
+  llvm::stable_sort(Candidates, [](const Candidate &A, const Candidate &B) {
+    return std::make_tuple(!A.Pinned, !A.InAllPreds, A.Dist) <
+           std::make_tuple(!B.Pinned, !B.InAllPreds, B.Dist);
+  });
+
+  for (const Candidate &C : Candidates) {
+    if (!C.Pinned && !fits(C.Reg))
+      continue;
+    W.push_back(C.Reg);
+    addPressure(C.Reg);
+  }
+}
+
+void SSASpiller::processBlock(MachineBasicBlock &MBB) {
+  BlockInfo &BI = Blocks[MBB.getNumber()];
+  LLVM_DEBUG(dbgs() << "SSA spilling in " << printMBBReference(MBB) << '\n');
+
+  std::fill(Pressure.begin(), Pressure.end(), 0);
+  RegSet W;
+  computeEntrySet(MBB, W);
+  BI.Entry = W;
+
+  // Positions of the reads in this block, for the next-use distances.
+  DenseMap<Register, SmallVector<unsigned, 4>> UsePositions;
+  unsigned Pos = 0;
+  for (const MachineInstr &MI : MBB) {
+    if (MI.isDebugInstr())
+      continue;
+    for (const MachineOperand &MO : MI.operands()) {
+      if (!MO.isReg() || !MO.readsReg() || !isCounted(MO.getReg()))
+        continue;
+      SmallVectorImpl<unsigned> &Positions = UsePositions[MO.getReg()];
+      if (Positions.empty() || Positions.back() != Pos)
+        Positions.push_back(Pos);
+    }
+    ++Pos;
+  }
+
+  // Distance from the current instruction to the next read of Reg after it.
+  Pos = 0;
+  auto NextUse = [&](Register Reg) -> unsigned {
+    auto It = UsePositions.find(Reg);
+    if (It != UsePositions.end()) {
+      auto Next = llvm::upper_bound(It->second, Pos);
+      if (Next != It->second.end())
+        return *Next - Pos;
+    }
+    return addDistance(BI.Length - Pos, getExitDistance(MBB, Reg));
+  };
+
+  for (MachineInstr &MI : MBB) {
+    if (MI.isDebugInstr())
+      continue;
+
+    SmallVector<Register, 4> Uses, Defs;
+    for (const MachineOperand &MO : MI.operands()) {
+      if (!MO.isReg() || !isCounted(MO.getReg()))
+        continue;
+      Register Reg = MO.getReg();
+      if (MO.readsReg() && !is_contained(Uses, Reg))
+        Uses.push_back(Reg);
+      if (MO.isDef() && !is_contained(Defs, Reg))
+        Defs.push_back(Reg);
+    }
+
+    // The operands must be in registers.
+    for (Register Reg : Uses) {
+      if (is_contained(W, Reg))
+        continue;
+      ReloadsBefore.push_back({&MI, Reg});
+      Reloaded.insert(Reg);
+      W.push_back(Reg);
+      addPressure(Reg);
+    }
+    limit(W, Uses, Limits, NextUse);
+
+    SlotIndex Idx = LIS.getInstructionIndex(MI);
+    for (Register Reg : Uses) {
+      if (!LIS.getInterval(Reg).Query(Idx).isKill())
+        continue;
+      llvm::erase(W, Reg);
+      removePressure(Reg);
+    }
+
+    for (Register Reg : Defs) {
+      if (is_contained(W, Reg))
+        continue;
+      W.push_back(Reg);
+      addPressure(Reg);
+    }
+    limit(W, Defs, Limits, NextUse);
+
+    for (Register Reg : Defs) {
+      if (!is_contained(W, Reg) ||
+          !LIS.getInterval(Reg).Query(Idx).isDeadDef())
+        continue;
+      llvm::erase(W, Reg);
+      removePressure(Reg);
+    }
+
+    // The values defined by a call don't live across it.
+    if (const uint32_t *RegMask = getRegMask(MI)) {
+      for (Register Reg : Defs)
+        if (is_contained(W, Reg))
+          removePressure(Reg);
+      limit(W, Defs, getCallLimits(RegMask), NextUse);
+      for (Register Reg : Defs)
+        if (is_contained(W, Reg))
+          addPressure(Reg);
+    }
+    ++Pos;
+  }
+
+  // Values killed on the way out of the block, e.g. by a redefinition on the
+  // other side of a hole, don't need a register at the exit.
+  llvm::erase_if(W, [&](Register Reg) {
+    return !LIS.isLiveOutOfMBB(LIS.getInterval(Reg), &MBB);
+  });
+  BI.Exit = W;
+  BI.Visited = true;
+}
+
+bool SSASpiller::fitsAtExit(const MachineBasicBlock &MBB, Register Reg) {
+  // The exit set, the values read by the terminators, and the values already
+  // reloaded on the way out of MBB.
+  RegSet Live = Blocks[MBB.getNumber()].Exit;
+  for (const MachineInstr &MI : MBB.terminators())
+    for (const MachineOperand &MO : MI.operands())
+      if (MO.isReg() && MO.readsReg() && isCounted(MO.getReg()) &&
+          !is_contained(Live, MO.getReg()))
+        Live.push_back(MO.getReg());
+  for (auto [Pred, Other] : ExitReloads)
+    if (Pred == &MBB && !is_contained(Live, Other))
+      Live.push_back(Other);
+  if (is_contained(Live, Reg))
+    return true;
+
+  std::fill(Pressure.begin(), Pressure.end(), 0);
+  for (Register Other : Live)
+    addPressure(Other);
+  return fits(Reg);
+}
+
+void SSASpiller::connectBlocks() {
+  for (MachineBasicBlock &MBB : MF) {
+    const BlockInfo &BI = Blocks[MBB.getNumber()];
+    if (!BI.Visited)
+      continue;
+    for (Register Reg : BI.Entry) {
+      if (!Evictable[Reg.virtRegIndex()])
+        continue;
+      SmallVector<MachineBasicBlock *, 4> Missing;
+      for (MachineBasicBlock *Pred : MBB.predecessors()) {
+        const BlockInfo &PI = Blocks[Pred->getNumber()];
+        if (PI.Visited && !is_contained(PI.Exit, Reg))
+          Missing.push_back(Pred);
+      }
+      if (Missing.empty())
+        continue;
+      Reloaded.insert(Reg);
+
+      // The stack slot is up to date on every path, so a reload at the entry
+      // is also correct on the edges where the value is in a register. Use it
+      // when it executes less often than the reloads on the edges, and when
+      // a reload at the end of a predecessor would also reach its other
+      // successors or exceed the register limit there.
+      bool OnEdges = llvm::all_of(Missing, [&](MachineBasicBlock *Pred) {
+        return Pred->succ_size() == 1 && fitsAtExit(*Pred, Reg);
+      });
+      if (!OnEdges || isParallelCopyCheaperAtEntry(MBB, Missing, MBFI)) {
+        EntryReloads.insert({&MBB, Reg});
+        continue;
+      }
+      for (MachineBasicBlock *Pred : Missing)
+        ExitReloads.insert({Pred, Reg});
+    }
+  }
+}
+
+void SSASpiller::insertSpillCode() {
+  InsertPointAnalysis IPA(LIS, MF.getNumBlockIDs());
+
+  // Compute all insertion points before the function changes.
+  struct Insertion {
+    MachineBasicBlock *MBB;
+    MachineBasicBlock::iterator InsertPt;
+    Register Reg;
+  };
+  SmallVector<Insertion, 16> Spills, Reloads;
+  for (auto [MI, Reg] : ReloadsBefore) {
+    MachineBasicBlock *MBB = MI->getParent();
+    Reloads.push_back({MBB,
+                       MI->isTerminator() ? MBB->getFirstTerminator()
+                                          : MachineBasicBlock::iterator(MI),
+                       Reg});
+  }
+  for (auto [MBB, Reg] : EntryReloads)
+    Reloads.push_back({MBB, MBB->SkipPHIsLabelsAndDebug(MBB->begin()), Reg});
+  for (auto [MBB, Reg] : ExitReloads)
+    Reloads.push_back(
+        {MBB, IPA.getLastInsertPointIter(LIS.getInterval(Reg), *MBB), Reg});
+
+  for (Register Reg : Reloaded) {
+    if (RematDefs[Reg.virtRegIndex()])
+      continue;
+    SmallPtrSet<MachineInstr *, 4> Visited;
+    for (MachineInstr &DefMI : MRI.def_instructions(Reg)) {
+      if (!Visited.insert(&DefMI).second || DefMI.registerDefIsDead(Reg, &TRI))
+        continue;
+      // An undefined value doesn't need to be stored.
+      if (DefMI.isImplicitDef() && !DefMI.getOperand(0).getSubReg())
+        continue;
+      Spills.push_back({DefMI.getParent(),
+                        std::next(MachineBasicBlock::iterator(DefMI)), Reg});
+    }
+
+    // The stack slot is live wherever the original value was.
+    int StackSlot = VRM.getStackSlot(Reg);
+    if (StackSlot == VirtRegMap::NO_STACK_SLOT)
+      StackSlot = VRM.assignVirt2StackSlot(Reg);
+    LiveInterval &StackInt =
+        LSS.getOrCreateInterval(StackSlot, MRI.getRegClass(Reg));
+    if (!StackInt.hasAtLeastOneValue())
+      StackInt.getNextValue(SlotIndex(), LSS.getVNInfoAllocator());
+    StackInt.MergeSegmentsInAsValue(LIS.getInterval(Reg),
+                                    StackInt.getValNumInfo(0));
+  }
+
+  // Stores go first, so a store and a reload at the same point stay ordered.
+  for (const Insertion &S : Spills) {
+    MachineInstrSpan MIS(S.InsertPt, S.MBB);
+    TII.storeRegToStackSlot(*S.MBB, S.InsertPt, S.Reg, /*isKill=*/false,
+                            VRM.getStackSlot(S.Reg), MRI.getRegClass(S.Reg),
+                            &TRI, Register());
+    LIS.InsertMachineInstrRangeInMaps(MIS.begin(), S.InsertPt);
+    ++SpillCount;
+  }
+  for (const Insertion &R : Reloads) {
+    MachineInstrSpan MIS(R.InsertPt, R.MBB);
+    if (const MachineInstr *DefMI = RematDefs[R.Reg.virtRegIndex()]) {
+      TII.reMaterialize(*R.MBB, R.InsertPt, R.Reg, 0, *DefMI, TRI);
+      ++RematCount;
+    } else {
+      TII.loadRegFromStackSlot(*R.MBB, R.InsertPt, R.Reg,
+                               VRM.getStackSlot(R.Reg), MRI.getRegClass(R.Reg),
+                               &TRI, Register());
+      ++ReloadCount;
+    }
+    LIS.InsertMachineInstrRangeInMaps(MIS.begin(), R.InsertPt);
+  }
+
+  // The reloads are new defs of the original registers; their live ranges now
+  // end where the values were evicted.
+  for (Register Reg : Reloaded) {
+    LIS.removeInterval(Reg);
+    LiveInterval *LI = &LIS.createAndComputeVirtRegInterval(Reg);
+    MachineInstr *DefMI = RematDefs[Reg.virtRegIndex()];
+    if (DefMI && LI->Query(LIS.getInstructionIndex(*DefMI)).isDeadDef()) {
+      LLVM_DEBUG(dbgs() << "SSA spiller deletes " << *DefMI);
+      LIS.RemoveMachineInstrFromMaps(*DefMI);
+      DefMI->eraseFromParent();
+      LIS.removeInterval(Reg);
+      LI = &LIS.createAndComputeVirtRegInterval(Reg);
+    }
+
+    // A value that was evicted and reloaded is made of disconnected pieces.
+    // Give each piece its own register, or they all need the same color.
+    SmallVector<LiveInterval *, 4> SplitLIs;
+    LIS.splitSeparateComponents(*LI, SplitLIs);
+    if (SplitLIs.empty())
+      continue;
+    VRM.grow();
+    int StackSlot = VRM.getStackSlot(Reg);
+    for (LiveInterval *SplitLI : SplitLIs) {
+      VRM.setIsSplitFromReg(SplitLI->reg(), VRM.getOriginal(Reg));
+      if (StackSlot != VirtRegMap::NO_STACK_SLOT)
+        VRM.assignVirt2StackSlot(SplitLI->reg(), StackSlot);
+    }
+    NumComponents += SplitLIs.size();
+  }
+  NumSpills += SpillCount;
+  NumReloads += ReloadCount;
+  NumRemats += RematCount;
+}
+
+bool SSASpiller::run() {
+  analyzeRegisters();
+  computeLimits();
+  computeNextUseDistances();
+
+  ReversePostOrderTraversal<MachineFunction *> RPOT(&MF);
+  for (MachineBasicBlock *MBB : RPOT)
+    processBlock(*MBB);
+  connectBlocks();
+
+  if (Reloaded.empty())
+    return false;
+  LLVM_DEBUG(dbgs() << "SSA spiller reloads or rematerializes "
+                    << Reloaded.size() << " values\n");
+  insertSpillCode();
+  return true;
+}
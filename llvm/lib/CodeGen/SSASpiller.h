@@ -0,0 +1,159 @@
+//===- SSASpiller.h - Belady spilling for the SSA allocator -----*- C++ -*-===//
+//
+// Part of the LLVM Project, under the Apache License v2.0 with LLVM Exceptions.
+// See https://llvm.org/LICENSE.txt for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+//
+//===----------------------------------------------------------------------===//
+//
+// The SSASpiller runs before the SSA register allocator colors anything. It
+// inserts spill and reload code so that the number of values of each register
+// pressure set held in registers never exceeds the number of registers in the
+// set. Coloring in dominance order then has enough registers at every point.
+//
+// Which values leave the register file is decided with Belady's MIN algorithm:
+// when a block runs out of registers, the value whose next use is furthest away
+// is evicted. Next-use distances are computed over the whole CFG, and edges
+// that leave a loop are made long, so values that are only used after a loop
+// are evicted before the loop instead of inside it.
+//
+// Values defined by a rematerializable instruction that reads no virtual
+// registers, like constants and frame addresses, are never stored. They are
+// recomputed where the other values would be reloaded, and are preferred as
+// eviction victims.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef LLVM_LIB_CODEGEN_SSASPILLER_H
+#define LLVM_LIB_CODEGEN_SSASPILLER_H
+
+#include "llvm/ADT/ArrayRef.h"
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/STLFunctionalExtras.h"
+#include "llvm/ADT/SetVector.h"
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/CodeGen/MachineBasicBlock.h"
+#include "llvm/CodeGen/Register.h"
+#include <functional>
+
+namespace llvm {
+
+class LiveIntervals;
+class LiveStacks;
+class MachineBlockFrequencyInfo;
+class MachineFunction;
+class MachineInstr;
+class MachineLoopInfo;
+class MachineRegisterInfo;
+class RegisterClassInfo;
+class TargetInstrInfo;
+class TargetRegisterInfo;
+class VirtRegMap;
+
+class LLVM_LIBRARY_VISIBILITY SSASpiller {
+  MachineFunction &MF;
+  LiveIntervals &LIS;
+  LiveStacks &LSS;
+  VirtRegMap &VRM;
+  const MachineLoopInfo &Loops;
+  const MachineBlockFrequencyInfo &MBFI;
+  const RegisterClassInfo &RegClassInfo;
+  MachineRegisterInfo &MRI;
+  const TargetInstrInfo &TII;
+  const TargetRegisterInfo &TRI;
+
+  /// Registers that are not handled by this allocator, e.g. because a filter
+  /// assigns them to another allocation pass.
+  std::function<bool(Register)> ShouldAllocate;
+
+  /// The set of values held in registers at a program point.
+  using RegSet = SmallVector<Register, 16>;
+
+  struct BlockInfo {
+    /// Number of non-debug instructions in the block.
+    unsigned Length = 0;
+    /// Virtual registers live into the block.
+    SmallVector<Register, 8> LiveIns;
+    /// Live-in values that are not read in the block.
+    SmallVector<Register, 8> LiveThrough;
+    /// Distance from the block entry to the next use of each live-in value.
+    DenseMap<Register, unsigned> NextUseIn;
+    /// Values in registers at the block entry and exit.
+    RegSet Entry, Exit;
+    bool Visited = false;
+  };
+  SmallVector<BlockInfo, 8> Blocks;
+
+  /// Values that are counted and may be evicted.
+  SmallVector<bool, 8> Evictable;
+  SmallVector<bool, 8> Counted;
+
+  /// The defining instruction of each value that is rematerialized instead
+  /// of reloaded, or null.
+  SmallVector<MachineInstr *, 8> RematDefs;
+
+  /// Register pressure set limits, at any point and across a call.
+  SmallVector<unsigned, 8> Limits;
+  DenseMap<const uint32_t *, SmallVector<unsigned, 8>> CallLimits;
+
+  /// Current register pressure per pressure set.
+  SmallVector<unsigned, 8> Pressure;
+
+  /// Decisions of the block walk, materialized by insertSpillCode().
+  SmallVector<std::pair<MachineInstr *, Register>, 16> ReloadsBefore;
+  SmallSetVector<std::pair<MachineBasicBlock *, Register>, 16> EntryReloads;
+  SmallSetVector<std::pair<MachineBasicBlock *, Register>, 16> ExitReloads;
+  SmallSetVector<Register, 16> Reloaded;
+
+  /// The spill code inserted for this function.
+  unsigned SpillCount = 0;
+  unsigned ReloadCount = 0;
+  unsigned RematCount = 0;
+
+  bool isCounted(Register Reg) const {
+    return Reg.isVirtual() && Counted[Reg.virtRegIndex()];
+  }
+
+  void analyzeRegisters();
+  void computeLimits();
+  ArrayRef<unsigned> getCallLimits(const uint32_t *RegMask);
+  void computeNextUseDistances();
+  unsigned getExitDistance(const MachineBasicBlock &MBB, Register Reg) const;
+
+  void addPressure(Register Reg);
+  void removePressure(Register Reg);
+  bool fits(Register Reg) const;
+  bool inPressureSet(Register Reg, unsigned PSet) const;
+  void computeEntrySet(MachineBasicBlock &MBB, RegSet &W);
+  void limit(RegSet &W, ArrayRef<Register> Protected, ArrayRef<unsigned> Limit,
+             function_ref<unsigned(Register)> Distance);
+  void processBlock(MachineBasicBlock &MBB);
+  /// Return true if \p Reg can be reloaded before the terminators of \p MBB
+  /// without exceeding the register limits.
+  bool fitsAtExit(const MachineBasicBlock &MBB, Register Reg);
+  void connectBlocks();
+  void insertSpillCode();
+
+public:
+  SSASpiller(MachineFunction &MF, LiveIntervals &LIS, LiveStacks &LSS,
+             VirtRegMap &VRM, const MachineLoopInfo &Loops,
+             const MachineBlockFrequencyInfo &MBFI,
+             const RegisterClassInfo &RegClassInfo,
+             std::function<bool(Register)> ShouldAllocate);
+
+  /// Insert the spill code. Return true if the function was changed.
+  bool run();
+
+  unsigned getNumSpills() const { return SpillCount; }
+  unsigned getNumReloads() const { return ReloadCount; }
+  unsigned getNumRemats() const { return RematCount; }
+
+  /// Return the single definition of \p Reg if it can be recomputed anywhere
+  /// instead of being reloaded, or null.
+  static MachineInstr *getRematDef(Register Reg, const MachineRegisterInfo &MRI,
+                                   const TargetInstrInfo &TII);
+};
+
+} // end namespace llvm
+
+#endif // LLVM_LIB_CODEGEN_SSASPILLER_H
@@ -11,6 +11,7 @@
 #include "llvm/CodeGen/MachineFunction.h"
 #include "llvm/Config/llvm-config.h"
 #include "llvm/InitializePasses.h"
+#include "llvm/Support/CommandLine.h"
 #include "llvm/Support/Debug.h"
 #include "llvm/Support/raw_ostream.h"
 
@@ -48,6 +49,14 @@ INITIALIZE_PASS(SlotIndexesWrapperPass, DEBUG_TYPE, "Slot index numbering",
                 false, false)
 
 STATISTIC(NumLocalRenum,  "Number of local renumberings");
+STATISTIC(NumRenumEntries, "Number of indexes changed by local renumberings");
+STATISTIC(MaxRenumEntries, "Most indexes changed by one local renumbering");
+
+static cl::opt<bool> WindowRenumbering(
+    "slotindexes-window-renumbering",
+    cl::desc("Renumber slot indexes by spreading out a growing window around "
+             "the new index instead of shifting all following indexes"),
+    cl::init(false), cl::Hidden);
 
 void SlotIndexesWrapperPass::getAnalysisUsage(AnalysisUsage &au) const {
   au.setPreservesAll();
@@ -170,21 +179,84 @@ void SlotIndexes::removeSingleMachineInstrFromMaps(MachineInstr &MI) {
 // Renumber indexes locally after curItr was inserted, but failed to get a new
 // index.
 void SlotIndexes::renumberIndexes(IndexList::iterator curItr) {
-  // Number indexes with half the default spacing so we can catch up quickly.
-  const unsigned Space = SlotIndex::InstrDist/2;
-  static_assert((Space & 3) == 0, "InstrDist must be a multiple of 2*NUM");
-
-  IndexList::iterator startItr = std::prev(curItr);
-  unsigned index = startItr->getIndex();
-  do {
-    curItr->setIndex(index += Space);
-    ++curItr;
-    // If the next index is bigger, we have caught up.
-  } while (curItr != indexList.end() && curItr->getIndex() <= index);
-
-  LLVM_DEBUG(dbgs() << "\n*** Renumbered SlotIndexes " << startItr->getIndex()
-                    << '-' << index << " ***\n");
+  unsigned NumChanged;
+  if (WindowRenumbering) {
+    NumChanged = renumberWindow(curItr);
+  } else {
+    // Number indexes with half the default spacing so we can catch up
+    // quickly.
+    const unsigned Space = SlotIndex::InstrDist/2;
+    static_assert((Space & 3) == 0, "InstrDist must be a multiple of 2*NUM");
+
+    IndexList::iterator startItr = std::prev(curItr);
+    unsigned index = startItr->getIndex();
+    NumChanged = 0;
+    do {
+      curItr->setIndex(index += Space);
+      ++curItr;
+      ++NumChanged;
+      // If the next index is bigger, we have caught up.
+    } while (curItr != indexList.end() && curItr->getIndex() <= index);
+
+    LLVM_DEBUG(dbgs() << "\n*** Renumbered SlotIndexes "
+                      << startItr->getIndex() << '-' << index << " ***\n");
+  }
   ++NumLocalRenum;
+  NumRenumEntries += NumChanged;
+  MaxRenumEntries.updateMax(NumChanged);
+}
+
+// This is the order maintenance scheme of Bender et al., "Two Simplified
+// Algorithms for Maintaining Order in a List", with windows counted in
+// entries. The window doubles until the gap between its neighbors leaves
+// every entry a share of at least the density threshold. The threshold starts
+// at InstrDist and shrinks towards InstrDist/2 as the window grows. After the
+// window is spread out, each smaller window inside it can take a constant
+// fraction of its size in new entries before it has to be renumbered again.
+// Spreading never leaves a gap below InstrDist/2, so the next insertion into
+// any of the gaps finds room.
+unsigned SlotIndexes::renumberWindow(IndexList::iterator curItr) {
+  // The new entry shares the index of its predecessor until renumbered.
+  IndexList::iterator Before = std::prev(curItr);
+  IndexList::iterator After = std::next(curItr);
+  curItr->setIndex(Before->getIndex());
+  unsigned Count = 1;
+
+  // The threshold in 1/65536ths of an index.
+  const uint64_t MinGap = uint64_t(SlotIndex::InstrDist / 2) << 16;
+  uint64_t Gap = uint64_t(SlotIndex::InstrDist) << 16;
+  while (After != indexList.end() &&
+         uint64_t(After->getIndex() - Before->getIndex()) << 16 <
+             (Count + 1) * Gap) {
+    // The first entry stays at the zero index.
+    unsigned Grow = (Count + 1) / 2;
+    for (unsigned I = 0; I != Grow && Before != indexList.begin(); ++I) {
+      --Before;
+      ++Count;
+    }
+    for (unsigned I = 0; I != Grow && After != indexList.end(); ++I) {
+      ++After;
+      ++Count;
+    }
+    Gap = MinGap + (Gap - MinGap) * 3 / 4;
+  }
+
+  unsigned Base = Before->getIndex();
+  IndexList::iterator I = std::next(Before);
+  if (After == indexList.end()) {
+    // Nothing bounds the window from above.
+    for (unsigned K = 1; I != After; ++I, ++K)
+      I->setIndex(Base + K * SlotIndex::InstrDist);
+  } else {
+    uint64_t Span = After->getIndex() - Base;
+    for (unsigned K = 1; I != After; ++I, ++K)
+      I->setIndex(Base + (unsigned(Span * K / (Count + 1)) &
+                          ~unsigned(SlotIndex::Slot_Count - 1)));
+  }
+
+  LLVM_DEBUG(dbgs() << "\n*** Renumbered " << Count << " SlotIndexes after "
+                    << Base << " ***\n");
+  return Count;
 }
 
 // Repair indexes after adding and removing instructions.
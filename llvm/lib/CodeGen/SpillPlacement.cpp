@@ -28,6 +28,7 @@
 
 #include "llvm/CodeGen/SpillPlacement.h"
 #include "llvm/ADT/BitVector.h"
+#include "llvm/ADT/STLExtras.h"
 #include "llvm/CodeGen/EdgeBundles.h"
 #include "llvm/CodeGen/MachineBasicBlock.h"
 #include "llvm/CodeGen/MachineBlockFrequencyInfo.h"
@@ -35,6 +36,7 @@
 #include "llvm/CodeGen/Passes.h"
 #include "llvm/InitializePasses.h"
 #include "llvm/Pass.h"
+#include "llvm/Support/CommandLine.h"
 #include <algorithm>
 #include <cassert>
 #include <cstdint>
@@ -44,6 +46,11 @@ using namespace llvm;
 
 #define DEBUG_TYPE "spill-code-placement"
 
+static cl::opt<bool> SaturatingLinkSums(
+    "spill-placement-saturating-sums", cl::Hidden, cl::init(false),
+    cl::desc("Sum the link weights of each spill placement node with "
+             "saturating additions, one link at a time"));
+
 char SpillPlacementWrapperLegacy::ID = 0;
 
 char &llvm::SpillPlacementID = SpillPlacementWrapperLegacy::ID;
@@ -66,9 +73,10 @@ void SpillPlacementWrapperLegacy::getAnalysisUsage(AnalysisUsage &AU) const {
 /// The node contains precomputed frequency data that only depends on the CFG,
 /// but Bias and Links are computed each time placeSpills is called.
 ///
-/// The node Value is positive when the variable should be in a register. The
-/// value can change when linked nodes change, but convergence is very fast
-/// because all weights are positive.
+/// The output value of each node is kept in SpillPlacement::NodeValues. It is
+/// positive when the variable should be in a register. The value can change
+/// when linked nodes change, but convergence is very fast because all weights
+/// are positive.
 struct SpillPlacement::Node {
   /// BiasN - Sum of blocks that prefer a spill.
   BlockFrequency BiasN;
@@ -76,26 +84,15 @@ struct SpillPlacement::Node {
   /// BiasP - Sum of blocks that prefer a register.
   BlockFrequency BiasP;
 
-  /// Value - Output value of this node computed from the Bias and links.
-  /// This is always on of the values {-1, 0, 1}. A positive number means the
-  /// variable should go in a register through this bundle.
-  int Value;
-
-  using LinkVector = SmallVector<std::pair<BlockFrequency, unsigned>, 4>;
-
-  /// Links - (Weight, BundleNo) for all transparent blocks connecting to other
-  /// bundles. The weights are all positive block frequencies.
-  LinkVector Links;
+  /// LinkWeights, LinkNodes - Weight and BundleNo of all transparent blocks
+  /// connecting to other bundles. The weights are all positive block
+  /// frequencies. They are kept apart so computeValue reads both sequentially.
+  SmallVector<uint64_t, 4> LinkWeights;
+  SmallVector<unsigned, 4> LinkNodes;
 
   /// SumLinkWeights - Cached sum of the weights of all links + ThresHold.
   BlockFrequency SumLinkWeights;
 
-  /// preferReg - Return true when this node prefers to be in a register.
-  bool preferReg() const {
-    // Undecided nodes (Value==0) go on the stack.
-    return Value > 0;
-  }
-
   /// mustSpill - Return True if this node is so biased that it must spill.
   bool mustSpill() const {
     // We must spill if Bias < -sum(weights) or the MustSpill flag was set.
@@ -109,9 +106,9 @@ struct SpillPlacement::Node {
   void clear(BlockFrequency Threshold) {
     BiasN = BlockFrequency(0);
     BiasP = BlockFrequency(0);
-    Value = 0;
     SumLinkWeights = Threshold;
-    Links.clear();
+    LinkWeights.clear();
+    LinkNodes.clear();
   }
 
   /// addLink - Add a link to bundle b with weight w.
@@ -120,13 +117,15 @@ struct SpillPlacement::Node {
     SumLinkWeights += w;
 
     // There can be multiple links to the same bundle, add them up.
-    for (std::pair<BlockFrequency, unsigned> &L : Links)
-      if (L.second == b) {
-        L.first += w;
-        return;
-      }
+    auto It = llvm::find(LinkNodes, b);
+    if (It != LinkNodes.end()) {
+      uint64_t &Weight = LinkWeights[It - LinkNodes.begin()];
+      Weight = (BlockFrequency(Weight) + w).getFrequency();
+      return;
+    }
     // This must be the first link to b.
-    Links.push_back(std::make_pair(w, b));
+    LinkWeights.push_back(w.getFrequency());
+    LinkNodes.push_back(b);
   }
 
   /// addBias - Bias this node.
@@ -146,17 +145,32 @@ struct SpillPlacement::Node {
     }
   }
 
-  /// update - Recompute Value from Bias and Links. Return true when node
-  /// preference changes.
-  bool update(const Node nodes[], BlockFrequency Threshold) {
-    // Compute the weighted sum of inputs.
+  /// computeValue - Return the value of this node given the values of all
+  /// nodes.
+  int8_t computeValue(const int8_t Values[], BlockFrequency Threshold) const {
+    // Compute the weighted sum of inputs. Saturating additions of positive
+    // numbers can be done in any order, so the links are summed on their own.
+    // Unless SumLinkWeights saturated, their total fits in 64 bits and the
+    // loop needs neither saturation nor branches. The saturating loop can be
+    // forced with -spill-placement-saturating-sums to compare the two.
     BlockFrequency SumN = BiasN;
     BlockFrequency SumP = BiasP;
-    for (std::pair<BlockFrequency, unsigned> &L : Links) {
-      if (nodes[L.second].Value == -1)
-        SumN += L.first;
-      else if (nodes[L.second].Value == 1)
-        SumP += L.first;
+    if (SumLinkWeights != BlockFrequency::max() && !SaturatingLinkSums) {
+      uint64_t LinkN = 0, LinkP = 0;
+      for (unsigned I = 0, E = LinkNodes.size(); I != E; ++I) {
+        int8_t V = Values[LinkNodes[I]];
+        LinkN += V < 0 ? LinkWeights[I] : 0;
+        LinkP += V > 0 ? LinkWeights[I] : 0;
+      }
+      SumN += BlockFrequency(LinkN);
+      SumP += BlockFrequency(LinkP);
+    } else {
+      for (unsigned I = 0, E = LinkNodes.size(); I != E; ++I) {
+        if (Values[LinkNodes[I]] < 0)
+          SumN += BlockFrequency(LinkWeights[I]);
+        else if (Values[LinkNodes[I]] > 0)
+          SumP += BlockFrequency(LinkWeights[I]);
+      }
     }
 
     // Each weighted sum is going to be less than the total frequency of the
@@ -167,25 +181,11 @@ struct SpillPlacement::Node {
     //     initial iterations.
     //  2. It helps tame rounding errors when the links nominally sum to 0.
     //
-    bool Before = preferReg();
     if (SumN >= SumP + Threshold)
-      Value = -1;
-    else if (SumP >= SumN + Threshold)
-      Value = 1;
-    else
-      Value = 0;
-    return Before != preferReg();
-  }
-
-  void getDissentingNeighbors(SparseSet<unsigned> &List,
-                              const Node nodes[]) const {
-    for (const auto &Elt : Links) {
-      unsigned n = Elt.second;
-      // Neighbors that already have the same value are not going to
-      // change because of this node changing.
-      if (Value != nodes[n].Value)
-        List.insert(n);
-    }
+      return -1;
+    if (SumP >= SumN + Threshold)
+      return 1;
+    return 0;
   }
 };
 
@@ -226,6 +226,7 @@ SpillPlacement::SpillPlacement(SpillPlacement &&) = default;
 
 void SpillPlacement::releaseMemory() {
   nodes.reset();
+  NodeValues.reset();
   TodoList.clear();
 }
 
@@ -237,6 +238,7 @@ void SpillPlacement::run(MachineFunction &mf, EdgeBundles *Bundles,
 
   assert(!nodes && "Leaking node array");
   nodes.reset(new Node[bundles->getNumBundles()]);
+  NodeValues.reset(new int8_t[bundles->getNumBundles()]());
   TodoList.clear();
   TodoList.setUniverse(bundles->getNumBundles());
 
@@ -256,6 +258,7 @@ void SpillPlacement::activate(unsigned n) {
     return;
   ActiveNodes->set(n);
   nodes[n].clear(Threshold);
+  NodeValues[n] = 0;
 
   // Very large bundles usually come from big switches, indirect branches,
   // landing pads, or loops with many 'continue' statements. It is difficult to
@@ -348,16 +351,23 @@ bool SpillPlacement::scanActiveBundles() {
     // change its value ever again, so exclude it from iterations.
     if (nodes[n].mustSpill())
       continue;
-    if (nodes[n].preferReg())
+    if (preferReg(n))
       RecentPositive.push_back(n);
   }
   return !RecentPositive.empty();
 }
 
 bool SpillPlacement::update(unsigned n) {
-  if (!nodes[n].update(nodes.get(), Threshold))
+  bool Before = preferReg(n);
+  int8_t Value = nodes[n].computeValue(NodeValues.get(), Threshold);
+  NodeValues[n] = Value;
+  if (Before == preferReg(n))
     return false;
-  nodes[n].getDissentingNeighbors(TodoList, nodes.get());
+  // Neighbors that already have the same value are not going to change
+  // because of this node changing.
+  for (unsigned Neighbor : nodes[n].LinkNodes)
+    if (NodeValues[Neighbor] != Value)
+      TodoList.insert(Neighbor);
   return true;
 }
 
@@ -377,7 +387,7 @@ void SpillPlacement::iterate() {
     unsigned n = TodoList.pop_back_val();
     if (!update(n))
       continue;
-    if (nodes[n].preferReg())
+    if (preferReg(n))
       RecentPositive.push_back(n);
   }
 }
@@ -398,7 +408,7 @@ SpillPlacement::finish() {
   // Write preferences back to ActiveNodes.
   bool Perfect = true;
   for (unsigned n : ActiveNodes->set_bits())
-    if (!nodes[n].preferReg()) {
+    if (!preferReg(n)) {
       ActiveNodes->reset(n);
       Perfect = false;
     }
@@ -214,6 +214,11 @@ static cl::opt<bool> MISchedPostRA(
 static cl::opt<bool> EarlyLiveIntervals("early-live-intervals", cl::Hidden,
     cl::desc("Run live interval analysis earlier in the pipeline"));
 
+static cl::opt<bool> RegAllocScoreReport(
+    "regalloc-score-report", cl::Hidden,
+    cl::desc("Report the register allocation score as statistics and "
+             "analysis remarks after any register allocator"));
+
 static cl::opt<bool> DisableReplaceWithVecLib(
     "disable-replace-with-vec-lib", cl::Hidden,
     cl::desc("Disable replace with vector math call pass"));
@@ -1156,6 +1161,11 @@ void TargetPassConfig::addMachinePasses() {
   else
     addFastRegAlloc();
 
+  // Report the quality of the allocation, whichever allocator ran. The report
+  // needs block frequencies, so it is only added on request.
+  if (RegAllocScoreReport)
+    addPass(&RegAllocScoreReportID);
+
   // Run post-ra passes.
   addPostRegAlloc();
 
@@ -30,6 +30,7 @@
 #include "llvm/CodeGen/MachineInstr.h"
 #include "llvm/CodeGen/MachineOperand.h"
 #include "llvm/CodeGen/MachineRegisterInfo.h"
+#include "llvm/CodeGen/ParallelCopy.h"
 #include "llvm/CodeGen/SlotIndexes.h"
 #include "llvm/CodeGen/TargetFrameLowering.h"
 #include "llvm/CodeGen/TargetInstrInfo.h"
@@ -52,6 +53,7 @@ using namespace llvm;
 
 STATISTIC(NumSpillSlots, "Number of spill slots allocated");
 STATISTIC(NumIdCopies,   "Number of identity moves eliminated after rewriting");
+STATISTIC(NumCopyCycles, "Number of copy bundle cycles broken");
 
 //===----------------------------------------------------------------------===//
 //  VirtRegMap implementation
@@ -215,7 +217,10 @@ class VirtRegRewriter {
   bool readsUndefSubreg(const MachineOperand &MO) const;
   void addLiveInsForSubRanges(const LiveInterval &LI, MCRegister PhysReg) const;
   void handleIdentityCopy(MachineInstr &MI);
-  void expandCopyBundle(MachineInstr &MI) const;
+  bool expandCopyBundle(MachineInstr &MI) const;
+  bool lowerCopyCycle(ArrayRef<MachineInstr *> Cycle, SlotIndex Idx) const;
+  MCRegister findCopyScratchReg(ArrayRef<MachineInstr *> Cycle,
+                                SlotIndex Idx) const;
   bool subRegLiveThrough(const MachineInstr &MI, MCRegister SuperPhysReg) const;
   LaneBitmask liveOutUndefPhiLanesForUndefSubregDef(
       const LiveInterval &LI, const MachineBasicBlock &MBB, unsigned SubReg,
@@ -510,10 +515,11 @@ void VirtRegRewriter::handleIdentityCopy(MachineInstr &MI) {
 /// The liverange splitting logic sometimes produces bundles of copies when
 /// subregisters are involved. Expand these into a sequence of copy instructions
 /// after processing the last in the bundle. Does not update LiveIntervals
-/// which we shouldn't need for this instruction anymore.
-void VirtRegRewriter::expandCopyBundle(MachineInstr &MI) const {
+/// which we shouldn't need for this instruction anymore. Return false if \p MI
+/// was erased.
+bool VirtRegRewriter::expandCopyBundle(MachineInstr &MI) const {
   if (!MI.isCopy() && !MI.isKill())
-    return;
+    return true;
 
   if (MI.isBundledWithPred() && !MI.isBundledWithSucc()) {
     SmallVector<MachineInstr *, 2> MIs({&MI});
@@ -524,10 +530,12 @@ void VirtRegRewriter::expandCopyBundle(MachineInstr &MI) const {
          std::next(MI.getReverseIterator()), E = MBB.instr_rend();
          I != E && I->isBundledWithSucc(); ++I) {
       if (!I->isCopy() && !I->isKill())
-        return;
+        return true;
       MIs.push_back(&*I);
     }
     MachineInstr *FirstMI = MIs.back();
+    SlotIndex BundleIdx =
+        Indexes ? Indexes->getInstructionIndex(*FirstMI) : SlotIndex();
 
     auto anyRegsAlias = [](const MachineInstr *Dst,
                            ArrayRef<MachineInstr *> Srcs,
@@ -542,7 +550,8 @@ void VirtRegRewriter::expandCopyBundle(MachineInstr &MI) const {
 
     // If any of the destination registers in the bundle of copies alias any of
     // the source registers, try to schedule the instructions to avoid any
-    // clobbering.
+    // clobbering. The copies that are left in a cycle come last, in MIs[0, E).
+    int NumCyclic = 0;
     for (int E = MIs.size(), PrevE = E; E > 1; PrevE = E) {
       for (int I = E; I--; )
         if (!anyRegsAlias(MIs[I], ArrayRef(MIs).take_front(E), TRI)) {
@@ -551,8 +560,7 @@ void VirtRegRewriter::expandCopyBundle(MachineInstr &MI) const {
           --E;
         }
       if (PrevE == E) {
-        MF->getFunction().getContext().emitError(
-            "register rewriting failed: cycle in copy bundle");
+        NumCyclic = E;
         break;
       }
     }
@@ -573,7 +581,89 @@ void VirtRegRewriter::expandCopyBundle(MachineInstr &MI) const {
       if (Indexes && BundledMI != FirstMI)
         Indexes->insertMachineInstrInMaps(*BundledMI);
     }
+
+    if (NumCyclic) {
+      ArrayRef<MachineInstr *> Cycle = ArrayRef(MIs).take_front(NumCyclic);
+      if (!lowerCopyCycle(Cycle, BundleIdx)) {
+        MF->getFunction().getContext().emitError(
+            "register rewriting failed: cycle in copy bundle");
+        return true;
+      }
+      return !is_contained(Cycle, &MI);
+    }
+  }
+  return true;
+}
+
+/// Replace the copies in \p Cycle, which are the last ones of the expanded
+/// bundle at \p Idx, by an equivalent sequence of copies and swaps. Return
+/// false if the copies are not plain register copies or the cycle can't be
+/// broken.
+bool VirtRegRewriter::lowerCopyCycle(ArrayRef<MachineInstr *> Cycle,
+                                     SlotIndex Idx) const {
+  SmallVector<std::pair<MCRegister, MCRegister>, 8> Copies;
+  for (const MachineInstr *CopyMI : Cycle) {
+    if (!CopyMI->isCopy() || CopyMI->getNumOperands() != 2 ||
+        CopyMI->getOperand(1).isUndef())
+      return false;
+    Copies.push_back({CopyMI->getOperand(0).getReg().asMCReg(),
+                      CopyMI->getOperand(1).getReg().asMCReg()});
   }
+  // Registers must be either identical or disjoint.
+  for (auto [DstA, SrcA] : Copies)
+    for (auto [DstB, SrcB] : Copies)
+      for (MCRegister A : {DstA, SrcA})
+        for (MCRegister B : {DstB, SrcB})
+          if (A != B && TRI->regsOverlap(A, B))
+            return false;
+
+  // The cycle was ordered last, so MIs[0] is the last copy of the sequence.
+  MachineInstr &LastMI = *Cycle.front();
+  MachineBasicBlock &MBB = *LastMI.getParent();
+  MachineBasicBlock::iterator InsertPt = std::next(LastMI.getIterator());
+  MachineInstrSpan MIS(InsertPt, &MBB);
+  if (!emitParallelCopy(MBB, InsertPt, LastMI.getDebugLoc(), Copies,
+                        findCopyScratchReg(Cycle, Idx)))
+    return false;
+  ++NumCopyCycles;
+
+  if (Indexes)
+    for (MachineInstr &NewMI : make_range(MIS.begin(), InsertPt))
+      Indexes->insertMachineInstrInMaps(NewMI);
+  for (MachineInstr *CopyMI : Cycle) {
+    if (Indexes)
+      Indexes->removeMachineInstrFromMaps(*CopyMI);
+    CopyMI->eraseFromParent();
+  }
+  return true;
+}
+
+/// Return a register that is free at the copy bundle at \p Idx and can hold a
+/// value of \p Cycle, or an invalid register if there is none.
+MCRegister
+VirtRegRewriter::findCopyScratchReg(ArrayRef<MachineInstr *> Cycle,
+                                    SlotIndex Idx) const {
+  if (!LIS || !LRM || !Idx.isValid())
+    return MCRegister();
+  MCRegister Src = Cycle.front()->getOperand(1).getReg().asMCReg();
+  SlotIndex Start = Idx.getBaseIndex(), End = Idx.getDeadSlot();
+  const TargetRegisterClass *RC = TRI->getMinimalPhysRegClass(Src);
+  for (MCRegister Reg : RC->getRawAllocationOrder(*MF)) {
+    if (MRI->isReserved(Reg) || LRM->checkInterference(Start, End, Reg))
+      continue;
+    // The copies themselves are live at Idx, so this also skips them.
+    if (any_of(TRI->regunits(Reg), [&](MCRegUnit Unit) {
+          return LIS->getRegUnit(Unit).overlaps(Start, End);
+        }))
+      continue;
+    if (any_of(Cycle, [&](const MachineInstr *CopyMI) {
+          return CopyMI->readsRegister(Reg, TRI) ||
+                 CopyMI->modifiesRegister(Reg, TRI);
+        }))
+      continue;
+    return Reg;
+  }
+  return MCRegister();
 }
 
 /// Check whether (part of) \p SuperPhysReg is live through \p MI.
@@ -752,10 +842,9 @@ void VirtRegRewriter::rewrite() {
 
       LLVM_DEBUG(dbgs() << "> " << MI);
 
-      expandCopyBundle(MI);
-
       // We can remove identity copies right now.
-      handleIdentityCopy(MI);
+      if (expandCopyBundle(MI))
+        handleIdentityCopy(MI);
     }
   }
 
@@ -633,6 +633,25 @@ void RISCVInstrInfo::copyPhysReg(MachineBasicBlock &MBB,
   llvm_unreachable("Impossible reg-to-reg copy");
 }
 
+unsigned RISCVInstrInfo::getSwapPhysRegsCost(MCRegister RegA,
+                                             MCRegister RegB) const {
+  // There is no swap instruction; exchange GPRs with three XORs.
+  if (RISCV::GPRNoX0RegClass.contains(RegA, RegB))
+    return 3;
+  return 0;
+}
+
+void RISCVInstrInfo::swapPhysRegs(MachineBasicBlock &MBB,
+                                  MachineBasicBlock::iterator MBBI,
+                                  const DebugLoc &DL, MCRegister RegA,
+                                  MCRegister RegB) const {
+  assert(RISCV::GPRNoX0RegClass.contains(RegA, RegB) && RegA != RegB &&
+         "Unexpected swap");
+  BuildMI(MBB, MBBI, DL, get(RISCV::XOR), RegA).addReg(RegA).addReg(RegB);
+  BuildMI(MBB, MBBI, DL, get(RISCV::XOR), RegB).addReg(RegB).addReg(RegA);
+  BuildMI(MBB, MBBI, DL, get(RISCV::XOR), RegA).addReg(RegA).addReg(RegB);
+}
+
 void RISCVInstrInfo::storeRegToStackSlot(MachineBasicBlock &MBB,
                                          MachineBasicBlock::iterator I,
                                          Register SrcReg, bool IsKill, int FI,
@@ -110,6 +110,12 @@ public:
                    bool KillSrc, bool RenamableDest = false,
                    bool RenamableSrc = false) const override;
 
+  unsigned getSwapPhysRegsCost(MCRegister RegA,
+                               MCRegister RegB) const override;
+  void swapPhysRegs(MachineBasicBlock &MBB, MachineBasicBlock::iterator MBBI,
+                    const DebugLoc &DL, MCRegister RegA,
+                    MCRegister RegB) const override;
+
   void storeRegToStackSlot(
       MachineBasicBlock &MBB, MachineBasicBlock::iterator MBBI, Register SrcReg,
       bool IsKill, int FrameIndex, const TargetRegisterClass *RC,
@@ -324,7 +324,7 @@ static FunctionPass *useDefaultRegisterAllocator() { return nullptr; }
 
 static llvm::once_flag InitializeDefaultRVVRegisterAllocatorFlag;
 
-/// -riscv-rvv-regalloc=<fast|basic|greedy> command line option.
+/// -riscv-rvv-regalloc=<fast|basic|greedy|ssa> command line option.
 /// This option could designate the rvv register allocator only.
 /// For example: -riscv-rvv-regalloc=basic
 static cl::opt<RVVRegisterRegAlloc::FunctionPassCtor, false,
@@ -354,6 +354,10 @@ static FunctionPass *createFastRVVRegisterAllocator() {
   return createFastRegisterAllocator(onlyAllocateRVVReg, false);
 }
 
+static FunctionPass *createSSARVVRegisterAllocator() {
+  return createSSARegisterAllocator(onlyAllocateRVVReg);
+}
+
 static RVVRegisterRegAlloc basicRegAllocRVVReg("basic",
                                                "basic register allocator",
                                                createBasicRVVRegisterAllocator);
@@ -364,6 +368,9 @@ static RVVRegisterRegAlloc
 static RVVRegisterRegAlloc fastRegAllocRVVReg("fast", "fast register allocator",
                                               createFastRVVRegisterAllocator);
 
+static RVVRegisterRegAlloc ssaRegAllocRVVReg("ssa", "SSA register allocator",
+                                             createSSARVVRegisterAllocator);
+
 class RISCVPassConfig : public TargetPassConfig {
 public:
   RISCVPassConfig(RISCVTargetMachine &TM, PassManagerBase &PM)
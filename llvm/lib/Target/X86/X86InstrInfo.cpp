@@ -4388,6 +4388,34 @@ void X86InstrInfo::copyPhysReg(MachineBasicBlock &MBB,
   report_fatal_error("Cannot emit physreg copy instruction");
 }
 
+static unsigned getXCHGOpcode(MCRegister RegA, MCRegister RegB) {
+  if (X86::GR64RegClass.contains(RegA, RegB))
+    return X86::XCHG64rr;
+  if (X86::GR32RegClass.contains(RegA, RegB))
+    return X86::XCHG32rr;
+  return 0;
+}
+
+unsigned X86InstrInfo::getSwapPhysRegsCost(MCRegister RegA,
+                                           MCRegister RegB) const {
+  // XCHG between two registers is three uops on current cores, as many as the
+  // moves of a rotation through a scratch register, and the moves are often
+  // eliminated at rename.
+  return getXCHGOpcode(RegA, RegB) ? 3 : 0;
+}
+
+void X86InstrInfo::swapPhysRegs(MachineBasicBlock &MBB,
+                                MachineBasicBlock::iterator MI,
+                                const DebugLoc &DL, MCRegister RegA,
+                                MCRegister RegB) const {
+  unsigned Opc = getXCHGOpcode(RegA, RegB);
+  assert(Opc && "Unexpected swap");
+  BuildMI(MBB, MI, DL, get(Opc), RegA)
+      .addReg(RegB, RegState::Define)
+      .addReg(RegA)
+      .addReg(RegB);
+}
+
 std::optional<DestSourcePair>
 X86InstrInfo::isCopyInstrImpl(const MachineInstr &MI) const {
   if (MI.isMoveReg()) {
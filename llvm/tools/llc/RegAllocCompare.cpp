@@ -0,0 +1,231 @@
+//===- RegAllocCompare.cpp - Compare register allocators in llc -----------===//
+//
+// Part of the LLVM Project, under the Apache License v2.0 with LLVM Exceptions.
+// See https://llvm.org/LICENSE.txt for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+//
+//===----------------------------------------------------------------------===//
+/// \file
+///
+/// The register allocator is chosen through the global RegisterRegAlloc
+/// default, so the allocators run one after the other, and each one compiles
+/// all the modules in parallel. Every module has its own LLVMContext and
+/// TargetMachine, which are only used by one thread at a time.
+///
+//===----------------------------------------------------------------------===//
+
+#include "RegAllocCompare.h"
+#include "NewPMDriver.h"
+#include "llvm/ADT/MapVector.h"
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/Analysis/TargetLibraryInfo.h"
+#include "llvm/CodeGen/MachineModuleInfo.h"
+#include "llvm/CodeGen/Passes.h"
+#include "llvm/CodeGen/RegAllocRegistry.h"
+#include "llvm/CodeGen/RegAllocStats.h"
+#include "llvm/CodeGen/TargetPassConfig.h"
+#include "llvm/IR/LLVMContext.h"
+#include "llvm/IR/LegacyPassManager.h"
+#include "llvm/IR/Module.h"
+#include "llvm/IR/Verifier.h"
+#include "llvm/IRReader/IRReader.h"
+#include "llvm/Support/JSON.h"
+#include "llvm/Support/SourceMgr.h"
+#include "llvm/Support/ThreadPool.h"
+#include "llvm/Support/WithColor.h"
+#include "llvm/Support/raw_ostream.h"
+#include "llvm/Target/RegisterTargetPassConfigCallback.h"
+#include "llvm/Target/TargetLoweringObjectFile.h"
+#include "llvm/Target/TargetMachine.h"
+#include "llvm/Transforms/Utils/Cloning.h"
+#include <optional>
+#include <vector>
+
+using namespace llvm;
+
+namespace {
+struct CompareInput {
+  std::string Filename;
+  std::unique_ptr<LLVMContext> Context;
+  std::unique_ptr<Module> M;
+  std::unique_ptr<TargetMachine> Target;
+  std::string Error;
+
+  /// The records of each allocator, and whether its compilation failed.
+  std::vector<std::vector<RegAllocFunctionStats>> Records;
+  SmallVector<bool, 8> Failed;
+};
+} // namespace
+
+static void parseInput(CompareInput &In,
+                       const CompareTargetFactory &CreateTarget) {
+  In.Context = std::make_unique<LLVMContext>();
+  In.Context->setDiagnosticHandler(std::make_unique<LLCDiagnosticHandler>());
+  SMDiagnostic Err;
+  In.M = parseIRFile(In.Filename, Err, *In.Context);
+  if (!In.M) {
+    raw_string_ostream OS(In.Error);
+    Err.print("", OS, /*ShowColors=*/false);
+    return;
+  }
+  raw_string_ostream OS(In.Error);
+  if (verifyModule(*In.M, &OS))
+    return;
+  In.Target = CreateTarget(*In.M, In.Error);
+}
+
+/// Compile a clone of In.M, appending the records to \p Records. Return false
+/// if the compilation reported an error.
+static bool compileInput(CompareInput &In,
+                         std::vector<RegAllocFunctionStats> &Records) {
+  std::unique_ptr<Module> Clone = CloneModule(*In.M);
+  TargetMachine &TM = *In.Target;
+  In.Context->setDiagnosticHandler(std::make_unique<LLCDiagnosticHandler>());
+
+  legacy::PassManager PM;
+  TargetLibraryInfoImpl TLII(Clone->getTargetTriple());
+  PM.add(new TargetLibraryInfoWrapperPass(TLII));
+  PM.add(new RegAllocStatsSink(&Records));
+  auto *MMIWP = new MachineModuleInfoWrapperPass(&TM);
+  raw_null_ostream OS;
+  if (TM.addPassesToEmitFile(PM, OS, nullptr, CodeGenFileType::Null,
+                             /*DisableVerify=*/true, MMIWP))
+    return false;
+  TM.getObjFileLowering()->Initialize(MMIWP->getMMI().getContext(), TM);
+  PM.run(*Clone);
+  return !In.Context->getDiagHandlerPtr()->HasErrors;
+}
+
+static void writeStats(json::OStream &J, const RegAllocFunctionStats &Stats) {
+  J.attribute("spills", Stats.Spills);
+  J.attribute("reloads", Stats.Reloads);
+  J.attribute("copies", Stats.Copies);
+  J.attribute("score", Stats.Score);
+  J.attribute("time_ms", Stats.WallTime * 1000.0);
+}
+
+static void writeInput(json::OStream &J, const CompareInput &In,
+                       ArrayRef<std::string> Allocators) {
+  if (!In.Target) {
+    J.object([&] {
+      J.attribute("file", In.Filename);
+      J.attribute("error", In.Error);
+    });
+    return;
+  }
+
+  // Functions in the order of their first record, with the record of each
+  // allocator.
+  MapVector<StringRef, SmallVector<const RegAllocFunctionStats *, 8>>
+      Functions;
+  for (unsigned A = 0, E = Allocators.size(); A != E; ++A) {
+    if (In.Failed[A])
+      continue;
+    for (const RegAllocFunctionStats &Stats : In.Records[A]) {
+      auto &PerAllocator = Functions[Stats.Name];
+      PerAllocator.resize(E);
+      PerAllocator[A] = &Stats;
+    }
+  }
+
+  for (const auto &[Name, PerAllocator] : Functions) {
+    J.object([&] {
+      J.attribute("file", In.Filename);
+      J.attribute("function", Name);
+      J.attributeObject("allocators", [&] {
+        for (unsigned A = 0, E = Allocators.size(); A != E; ++A)
+          if (const RegAllocFunctionStats *Stats = PerAllocator[A])
+            J.attributeObject(Allocators[A], [&] { writeStats(J, *Stats); });
+      });
+    });
+  }
+}
+
+int llvm::compareRegAllocators(StringRef Arg0,
+                               ArrayRef<std::string> InputFilenames,
+                               ArrayRef<std::string> Allocators,
+                               unsigned Threads,
+                               const CompareTargetFactory &CreateTarget,
+                               raw_ostream &OS) {
+  SmallVector<RegisterRegAlloc::FunctionPassCtor, 8> Ctors;
+  for (const std::string &Name : Allocators) {
+    RegisterRegAlloc *Node = RegisterRegAlloc::getList();
+    while (Node && Node->getName() != Name)
+      Node = Node->getNext();
+    if (!Node || Name == "default") {
+      WithColor::error(errs(), Arg0)
+          << "unknown register allocator '" << Name << "'\n";
+      return 1;
+    }
+    Ctors.push_back(Node->getCtor());
+  }
+
+  std::vector<CompareInput> Inputs(InputFilenames.size());
+  for (unsigned I = 0, E = InputFilenames.size(); I != E; ++I) {
+    Inputs[I].Filename = InputFilenames[I];
+    Inputs[I].Records.resize(Allocators.size());
+    Inputs[I].Failed.resize(Allocators.size());
+  }
+
+  DefaultThreadPool Pool(hardware_concurrency(Threads));
+  for (CompareInput &In : Inputs)
+    Pool.async([&] { parseInput(In, CreateTarget); });
+  Pool.wait();
+
+  // At -O0 the pipeline always uses the fast allocator, which rewrites the
+  // virtual registers itself, so there is nothing to compare and the collector
+  // would never run.
+  for (const CompareInput &In : Inputs) {
+    if (In.Target && In.Target->getOptLevel() == CodeGenOptLevel::None) {
+      WithColor::error(errs(), Arg0)
+          << "-compare-regalloc requires an optimization level above -O0\n";
+      return 1;
+    }
+  }
+
+  // Time the allocation from the last pass that runs before the allocator in
+  // the standard pipeline, and record the statistics once the virtual
+  // registers have been rewritten.
+  RegisterTargetPassConfigCallback InsertStatsPasses(
+      [](TargetMachine &, PassManagerBase &, TargetPassConfig *TPC) {
+        for (AnalysisID ID :
+             {&TwoAddressInstructionPassID, &RegisterCoalescerID,
+              &RenameIndependentSubregsID, &MachineSchedulerID})
+          TPC->insertPass(ID, &RegAllocStatsTimerID);
+        TPC->insertPass(&VirtRegRewriterID, &RegAllocStatsCollectorID);
+      });
+
+  for (unsigned A = 0, E = Allocators.size(); A != E; ++A) {
+    RegisterRegAlloc::setDefault(Ctors[A]);
+    for (CompareInput &In : Inputs) {
+      if (!In.Target)
+        continue;
+      Pool.async([&In, A] {
+        In.Failed[A] = !compileInput(In, In.Records[A]);
+      });
+    }
+    Pool.wait();
+  }
+
+  int RetVal = 0;
+  for (const CompareInput &In : Inputs) {
+    if (!In.Target) {
+      WithColor::error(errs(), Arg0) << In.Filename << ": " << In.Error;
+      RetVal = 1;
+      continue;
+    }
+    for (unsigned A = 0, E = Allocators.size(); A != E; ++A)
+      if (In.Failed[A])
+        WithColor::warning(errs(), Arg0)
+            << In.Filename << ": compilation with -regalloc=" << Allocators[A]
+            << " failed\n";
+  }
+
+  json::OStream J(OS, /*IndentSize=*/2);
+  J.array([&] {
+    for (const CompareInput &In : Inputs)
+      writeInput(J, In, Allocators);
+  });
+  OS << '\n';
+  return RetVal;
+}
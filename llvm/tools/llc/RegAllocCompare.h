@@ -0,0 +1,42 @@
+//===- RegAllocCompare.h - Compare register allocators in llc ---*- C++ -*-===//
+//
+// Part of the LLVM Project, under the Apache License v2.0 with LLVM Exceptions.
+// See https://llvm.org/LICENSE.txt for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+//
+//===----------------------------------------------------------------------===//
+/// \file
+///
+/// The -compare-regalloc mode of llc. Every input module is parsed once and
+/// compiled with a fresh clone for each requested register allocator. The
+/// allocation statistics of every function are written as JSON.
+///
+//===----------------------------------------------------------------------===//
+#ifndef LLVM_TOOLS_LLC_REGALLOCCOMPARE_H
+#define LLVM_TOOLS_LLC_REGALLOCCOMPARE_H
+
+#include "llvm/ADT/ArrayRef.h"
+#include "llvm/ADT/StringRef.h"
+#include <functional>
+#include <memory>
+#include <string>
+
+namespace llvm {
+class Module;
+class TargetMachine;
+class raw_ostream;
+
+/// Create the target machine for a freshly parsed module, and apply the
+/// command line function attributes to it. Called concurrently.
+using CompareTargetFactory =
+    std::function<std::unique_ptr<TargetMachine>(Module &, std::string &Error)>;
+
+/// Compile \p InputFilenames with each allocator in \p Allocators, using
+/// \p Threads threads (0 for all cores), and write the results to \p OS.
+int compareRegAllocators(StringRef Arg0, ArrayRef<std::string> InputFilenames,
+                         ArrayRef<std::string> Allocators, unsigned Threads,
+                         const CompareTargetFactory &CreateTarget,
+                         raw_ostream &OS);
+} // namespace llvm
+
+#endif
@@ -13,6 +13,7 @@
 //===----------------------------------------------------------------------===//
 
 #include "NewPMDriver.h"
+#include "RegAllocCompare.h"
 #include "llvm/ADT/STLExtras.h"
 #include "llvm/ADT/ScopeExit.h"
 #include "llvm/Analysis/TargetLibraryInfo.h"
@@ -70,6 +71,20 @@ static codegen::RegisterCodeGenFlags CGF;
 static cl::opt<std::string>
     InputFilename(cl::Positional, cl::desc("<input bitcode>"), cl::init("-"));
 
+static cl::list<std::string>
+    ExtraInputFilenames(cl::Positional,
+                        cl::desc("<more inputs for -compare-regalloc>"));
+
+static cl::list<std::string> CompareRegAlloc(
+    "compare-regalloc", cl::CommaSeparated, cl::value_desc("allocators"),
+    cl::desc("Compile every input with each listed register allocator, e.g. "
+             "basic,greedy,pbqp,fast,ssa, and print the allocation statistics "
+             "of each function as JSON"));
+
+static cl::opt<unsigned> CompareRegAllocThreads(
+    "compare-regalloc-threads", cl::init(0), cl::value_desc("N"),
+    cl::desc("Number of threads for -compare-regalloc (default = all cores)"));
+
 static cl::list<std::string>
     InstPrinterOptions("M", cl::desc("InstPrinter options"));
 
@@ -278,6 +293,7 @@ static void setPGOOptions(TargetMachine &TM) {
 }
 
 static int compileModule(char **, LLVMContext &);
+static int compareRegAllocators(const char *Arg0);
 
 [[noreturn]] static void reportError(Twine Msg, StringRef Filename = "") {
   SmallString<256> Prefix;
@@ -405,6 +421,14 @@ int main(int argc, char **argv) {
     return 1;
   }
 
+  if (!CompareRegAlloc.empty())
+    return compareRegAllocators(argv[0]);
+  if (!ExtraInputFilenames.empty()) {
+    WithColor::error(errs(), argv[0])
+        << "more than one input file requires -compare-regalloc\n";
+    return 1;
+  }
+
   if (TimeTrace)
     timeTraceProfilerInitialize(TimeTraceGranularity, argv[0]);
   auto TimeTraceScopeExit = make_scope_exit([]() {
@@ -447,6 +471,60 @@ int main(int argc, char **argv) {
   return 0;
 }
 
+static int compareRegAllocators(const char *Arg0) {
+  CodeGenOptLevel OLvl;
+  if (auto Level = CodeGenOpt::parseLevel(OptLevel)) {
+    OLvl = *Level;
+  } else {
+    WithColor::error(errs(), Arg0) << "invalid optimization level.\n";
+    return 1;
+  }
+
+  std::string CPUStr = codegen::getCPUStr(),
+              FeaturesStr = codegen::getFeaturesStr();
+  std::optional<Reloc::Model> RM = codegen::getExplicitRelocModel();
+  std::optional<CodeModel::Model> CM = codegen::getExplicitCodeModel();
+  auto CreateTarget = [&](Module &M, std::string &Error)
+      -> std::unique_ptr<TargetMachine> {
+    if (!TargetTriple.empty())
+      M.setTargetTriple(Triple(Triple::normalize(TargetTriple)));
+    Triple TheTriple = M.getTargetTriple();
+    if (TheTriple.getTriple().empty())
+      TheTriple.setTriple(sys::getDefaultTargetTriple());
+
+    const Target *TheTarget =
+        TargetRegistry::lookupTarget(codegen::getMArch(), TheTriple, Error);
+    if (!TheTarget)
+      return nullptr;
+    TargetOptions Options =
+        codegen::InitTargetOptionsFromCodeGenFlags(TheTriple);
+    std::unique_ptr<TargetMachine> Target(TheTarget->createTargetMachine(
+        TheTriple, CPUStr, FeaturesStr, Options, RM, CM, OLvl));
+    if (!Target) {
+      Error = "could not allocate target machine";
+      return nullptr;
+    }
+    M.setDataLayout(Target->createDataLayout());
+    codegen::setFunctionAttributes(CPUStr, FeaturesStr, M);
+    return Target;
+  };
+
+  std::vector<std::string> Inputs = {InputFilename};
+  llvm::append_range(Inputs, ExtraInputFilenames);
+
+  if (OutputFilename.empty())
+    OutputFilename = "-";
+  std::error_code EC;
+  ToolOutputFile Out(OutputFilename, EC, sys::fs::OF_TextWithCRLF);
+  if (EC)
+    reportError(EC.message(), OutputFilename);
+  int RetVal = llvm::compareRegAllocators(Arg0, Inputs, CompareRegAlloc,
+                                          CompareRegAllocThreads, CreateTarget,
+                                          Out.os());
+  Out.keep();
+  return RetVal;
+}
+
 static bool addPass(PassManagerBase &PM, const char *argv0, StringRef PassName,
                     TargetPassConfig &TPC) {
   if (PassName == "none")
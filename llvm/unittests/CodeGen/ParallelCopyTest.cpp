@@ -0,0 +1,129 @@
+//===- llvm/unittest/CodeGen/ParallelCopyTest.cpp - Parallel copy tests ---===//
+//
+// Part of the LLVM Project, under the Apache License v2.0 with LLVM Exceptions.
+// See https://llvm.org/LICENSE.txt for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+//
+//===----------------------------------------------------------------------===//
+
+#include "llvm/CodeGen/ParallelCopy.h"
+#include "llvm/ADT/DenseMap.h"
+#include "gtest/gtest.h"
+
+using namespace llvm;
+
+namespace {
+using CopyList = SmallVector<std::pair<unsigned, unsigned>, 8>;
+
+unsigned noSwap(unsigned, unsigned) { return 0; }
+unsigned nativeSwap(unsigned, unsigned) { return 1; }
+unsigned xorSwap(unsigned, unsigned) { return 3; }
+
+// Run Steps on a register file where each register initially holds its own
+// number, and check that every destination ends up with its source's value.
+void expectParallelSemantics(ArrayRef<std::pair<unsigned, unsigned>> Copies,
+                             ArrayRef<ParallelCopyStep> Steps) {
+  DenseMap<unsigned, unsigned> Value;
+  auto Get = [&](unsigned Reg) {
+    auto It = Value.find(Reg);
+    return It == Value.end() ? Reg : It->second;
+  };
+  for (const ParallelCopyStep &Step : Steps) {
+    unsigned Dst = Get(Step.Dst), Src = Get(Step.Src);
+    Value[Step.Dst] = Src;
+    if (Step.Kind == ParallelCopyStep::Swap)
+      Value[Step.Src] = Dst;
+  }
+  for (auto [Dst, Src] : Copies)
+    EXPECT_EQ(Src, Get(Dst)) << "register " << Dst;
+}
+
+unsigned countKind(ArrayRef<ParallelCopyStep> Steps,
+                   ParallelCopyStep::StepKind Kind) {
+  return count_if(Steps,
+                  [&](const ParallelCopyStep &S) { return S.Kind == Kind; });
+}
+} // namespace
+
+TEST(ParallelCopyTest, Empty) {
+  auto Steps = sequentializeParallelCopy({}, noSwap);
+  ASSERT_TRUE(Steps);
+  EXPECT_TRUE(Steps->empty());
+}
+
+TEST(ParallelCopyTest, IdentityCopiesAreDropped) {
+  CopyList Copies = {{1, 1}, {2, 2}};
+  auto Steps = sequentializeParallelCopy(Copies, noSwap);
+  ASSERT_TRUE(Steps);
+  EXPECT_TRUE(Steps->empty());
+}
+
+TEST(ParallelCopyTest, Chain) {
+  // 1 <- 2 <- 3 <- 4 must be emitted from the front of the chain.
+  CopyList Copies = {{3, 4}, {1, 2}, {2, 3}};
+  auto Steps = sequentializeParallelCopy(Copies, noSwap);
+  ASSERT_TRUE(Steps);
+  EXPECT_EQ(3u, Steps->size());
+  EXPECT_EQ(3u, countKind(*Steps, ParallelCopyStep::Copy));
+  expectParallelSemantics(Copies, *Steps);
+}
+
+TEST(ParallelCopyTest, FanOut) {
+  CopyList Copies = {{2, 1}, {3, 1}, {1, 4}};
+  auto Steps = sequentializeParallelCopy(Copies, noSwap);
+  ASSERT_TRUE(Steps);
+  EXPECT_EQ(3u, Steps->size());
+  expectParallelSemantics(Copies, *Steps);
+}
+
+TEST(ParallelCopyTest, CycleWithoutHelp) {
+  CopyList Copies = {{1, 2}, {2, 1}};
+  EXPECT_FALSE(sequentializeParallelCopy(Copies, noSwap));
+}
+
+TEST(ParallelCopyTest, CycleWithNativeSwap) {
+  // A 4-cycle takes 3 swaps.
+  CopyList Copies = {{1, 2}, {2, 3}, {3, 4}, {4, 1}};
+  auto Steps = sequentializeParallelCopy(Copies, nativeSwap, /*Scratch=*/9);
+  ASSERT_TRUE(Steps);
+  EXPECT_EQ(3u, Steps->size());
+  EXPECT_EQ(3u, countKind(*Steps, ParallelCopyStep::Swap));
+  expectParallelSemantics(Copies, *Steps);
+}
+
+TEST(ParallelCopyTest, CycleWithScratch) {
+  // A 3-cycle takes 4 copies through the scratch register, which is cheaper
+  // than two 3-instruction XOR swaps.
+  CopyList Copies = {{1, 2}, {2, 3}, {3, 1}};
+  auto Steps = sequentializeParallelCopy(Copies, xorSwap, /*Scratch=*/9);
+  ASSERT_TRUE(Steps);
+  EXPECT_EQ(4u, Steps->size());
+  EXPECT_EQ(0u, countKind(*Steps, ParallelCopyStep::Swap));
+  expectParallelSemantics(Copies, *Steps);
+}
+
+TEST(ParallelCopyTest, CycleWithXorSwap) {
+  CopyList Copies = {{1, 2}, {2, 3}, {3, 1}};
+  auto Steps = sequentializeParallelCopy(Copies, xorSwap);
+  ASSERT_TRUE(Steps);
+  EXPECT_EQ(2u, countKind(*Steps, ParallelCopyStep::Swap));
+  expectParallelSemantics(Copies, *Steps);
+}
+
+TEST(ParallelCopyTest, CycleWithTail) {
+  // The copy out of the cycle must read register 1 before the cycle moves it.
+  CopyList Copies = {{1, 2}, {2, 1}, {5, 1}, {6, 5}};
+  auto Steps = sequentializeParallelCopy(Copies, nativeSwap);
+  ASSERT_TRUE(Steps);
+  EXPECT_EQ(3u, Steps->size());
+  EXPECT_EQ(1u, countKind(*Steps, ParallelCopyStep::Swap));
+  expectParallelSemantics(Copies, *Steps);
+}
+
+TEST(ParallelCopyTest, SeveralCycles) {
+  CopyList Copies = {{1, 2}, {2, 1}, {3, 4}, {4, 5}, {5, 3}, {7, 7}};
+  auto Steps = sequentializeParallelCopy(Copies, nativeSwap);
+  ASSERT_TRUE(Steps);
+  EXPECT_EQ(3u, Steps->size());
+  expectParallelSemantics(Copies, *Steps);
+}
@@ -0,0 +1,99 @@
+//===- llvm/unittest/CodeGen/RegAllocGreedyQueueTest.cpp ------------------===//
+//
+// Part of the LLVM Project, under the Apache License v2.0 with LLVM Exceptions.
+// See https://llvm.org/LICENSE.txt for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+//
+//===----------------------------------------------------------------------===//
+
+#include "../lib/CodeGen/RegAllocGreedy.h"
+#include "gtest/gtest.h"
+
+using namespace llvm;
+
+namespace {
+using PQueue = RAGreedy::PQueue;
+
+// The order in which the greedy allocator must dequeue: highest priority
+// first, and lowest register first among equal priorities.
+std::vector<Register>
+expectedOrder(ArrayRef<std::pair<unsigned, unsigned>> In) {
+  std::vector<std::pair<unsigned, unsigned>> Sorted(In.begin(), In.end());
+  llvm::sort(Sorted, [](const auto &A, const auto &B) {
+    return A.first != B.first ? A.first > B.first : A.second < B.second;
+  });
+  std::vector<Register> Order;
+  for (const auto &[Prio, Idx] : Sorted)
+    Order.push_back(Register::index2VirtReg(Idx));
+  return Order;
+}
+
+std::vector<Register> popAll(PQueue &Q) {
+  std::vector<Register> Order;
+  while (!Q.empty())
+    Order.push_back(Q.pop());
+  return Order;
+}
+} // namespace
+
+TEST(RegAllocGreedyQueueTest, SamePopOrder) {
+  // (priority, virtual register index) pairs with equal priorities, and with
+  // priorities on both sides of the top-byte bucket boundaries.
+  std::pair<unsigned, unsigned> Entries[] = {
+      {0, 7},           {0, 3},           {0x00ffffff, 4},  {0x01000000, 9},
+      {0x01000000, 2},  {0x80000010, 5},  {0x80000010, 1},  {0x7fffffff, 8},
+      {0xffffffff, 6},  {0xff000000, 0},  {0x80000000, 11}, {0x00000001, 10},
+      {0x81000000, 12}, {0x80ffffff, 13}, {0x80000010, 14}, {0xffffffff, 15},
+  };
+
+  PQueue Plain;
+  PQueue Bucketed(/*Bucketed=*/true);
+  for (const auto &[Prio, Idx] : Entries) {
+    Plain.push(Prio, Register::index2VirtReg(Idx));
+    Bucketed.push(Prio, Register::index2VirtReg(Idx));
+  }
+  EXPECT_EQ(Plain.size(), std::size(Entries));
+  EXPECT_EQ(Bucketed.size(), std::size(Entries));
+
+  std::vector<Register> Expected = expectedOrder(Entries);
+  EXPECT_EQ(popAll(Plain), Expected);
+  EXPECT_EQ(popAll(Bucketed), Expected);
+}
+
+TEST(RegAllocGreedyQueueTest, InterleavedPushAndPop) {
+  // Requeue some of the popped registers with other priorities, as splitting
+  // and eviction do, and check that both queues keep dequeuing in the same
+  // order.
+  PQueue Plain;
+  PQueue Bucketed(/*Bucketed=*/true);
+  uint32_t Seed = 1;
+  auto Next = [&] {
+    Seed = Seed * 1103515245 + 12345;
+    return Seed >> 8;
+  };
+  // Few distinct buckets and low bits, so there are many ties.
+  auto NextPrio = [&] {
+    return (Next() % 4) << 30 | (Next() % 3) << 24 | Next() % 4;
+  };
+  unsigned NextIdx = 0;
+  for (unsigned Round = 0; Round != 50; ++Round) {
+    for (unsigned I = 0, E = Next() % 8; I != E; ++I) {
+      unsigned Prio = NextPrio();
+      Register Reg = Register::index2VirtReg(NextIdx++);
+      Plain.push(Prio, Reg);
+      Bucketed.push(Prio, Reg);
+    }
+    for (unsigned I = 0, E = Next() % 6; I != E && !Plain.empty(); ++I) {
+      ASSERT_FALSE(Bucketed.empty());
+      Register Reg = Plain.pop();
+      EXPECT_EQ(Bucketed.pop(), Reg);
+      if (Next() % 2) {
+        unsigned Prio = NextPrio();
+        Plain.push(Prio, Reg);
+        Bucketed.push(Prio, Reg);
+      }
+    }
+    EXPECT_EQ(Plain.size(), Bucketed.size());
+  }
+  EXPECT_EQ(popAll(Plain), popAll(Bucketed));
+}
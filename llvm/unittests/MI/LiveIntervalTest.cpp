@@ -1,15 +1,23 @@
+#include "llvm/ADT/BitVector.h"
 #include "llvm/ADT/STLExtras.h"
+#include "llvm/CodeGen/LiveIntervalUnion.h"
 #include "llvm/CodeGen/LiveIntervals.h"
 #include "llvm/CodeGen/LiveVariables.h"
 #include "llvm/CodeGen/MIRParser/MIRParser.h"
 #include "llvm/CodeGen/MachineFunction.h"
 #include "llvm/CodeGen/MachineModuleInfo.h"
+#include "llvm/CodeGen/MachineRegisterInfo.h"
+#include "llvm/CodeGen/MaxLive.h"
+#include "llvm/CodeGen/PackedLiveRange.h"
+#include "llvm/CodeGen/SSALiveness.h"
+#include "llvm/CodeGen/SpillPlacement.h"
 #include "llvm/CodeGen/TargetRegisterInfo.h"
 #include "llvm/CodeGen/TargetSubtargetInfo.h"
 #include "llvm/IR/LegacyPassManager.h"
 #include "llvm/IR/Module.h"
 #include "llvm/InitializePasses.h"
 #include "llvm/MC/TargetRegistry.h"
+#include "llvm/Support/CommandLine.h"
 #include "llvm/Support/MemoryBuffer.h"
 #include "llvm/Support/SourceMgr.h"
 #include "llvm/Support/TargetSelect.h"
@@ -237,6 +245,52 @@ body: |
   doTest<LiveIntervalsWrapperPass>(MIRString, T, ShouldPass);
 }
 
+static void maxLiveTest(StringRef MIRFunc,
+                        TestPassT<MaxLiveWrapperPass>::TestFx T) {
+  SmallString<160> S;
+  StringRef MIRString = (Twine(R"MIR(
+---
+...
+name: func
+registers:
+  - { id: 0, class: sreg_64 }
+body: |
+  bb.0:
+)MIR") + Twine(MIRFunc) + Twine("...\n")).toNullTerminatedStringRef(S);
+  doTest<MaxLiveWrapperPass>(MIRString, T);
+}
+
+static void ssaLivenessTest(StringRef MIRFunc,
+                            TestPassT<SSALivenessWrapperPass>::TestFx T) {
+  SmallString<160> S;
+  StringRef MIRString = (Twine(R"MIR(
+---
+...
+name: func
+registers:
+  - { id: 0, class: sreg_64 }
+body: |
+  bb.0:
+)MIR") + Twine(MIRFunc) + Twine("...\n")).toNullTerminatedStringRef(S);
+  doTest<SSALivenessWrapperPass>(MIRString, T);
+}
+
+static void
+spillPlacementTest(StringRef MIRFunc,
+                   TestPassT<SpillPlacementWrapperLegacy>::TestFx T) {
+  SmallString<160> S;
+  StringRef MIRString = (Twine(R"MIR(
+---
+...
+name: func
+registers:
+  - { id: 0, class: sreg_64 }
+body: |
+  bb.0:
+)MIR") + Twine(MIRFunc) + Twine("...\n")).toNullTerminatedStringRef(S);
+  doTest<SpillPlacementWrapperLegacy>(MIRString, T);
+}
+
 static void liveVariablesTest(StringRef MIRFunc,
                               TestPassT<LiveVariablesWrapperPass>::TestFx T,
                               bool ShouldPass = true) {
@@ -884,6 +938,343 @@ TEST(LiveIntervalTest, LiveThroughSegments) {
       false);
 }
 
+TEST(LiveIntervalTest, CallsCrossed) {
+  liveIntervalTest(
+      R"MIR(
+    %0 = IMPLICIT_DEF
+    %1:sreg_64 = IMPLICIT_DEF
+    $sgpr30_sgpr31 = SI_CALL %1, 0, csr_amdgpu
+    S_NOP 0, implicit %0
+    $sgpr30_sgpr31 = SI_CALL %1, 0, csr_amdgpu
+    %2:sreg_64 = IMPLICIT_DEF
+    S_NOP 0, implicit %0, implicit %2
+)MIR",
+      [](MachineFunction &MF, LiveIntervalsWrapperPass &LISWrapper) {
+        auto &LIS = LISWrapper.getLIS();
+        ASSERT_EQ(2u, LIS.getRegMaskSlots().size());
+
+        // %0 is live through both calls.
+        LiveInterval &LI0 =
+            LIS.getInterval(getMI(MF, 0, 0).getOperand(0).getReg());
+        EXPECT_TRUE(LIS.crossesCall(LI0));
+        EXPECT_EQ(2u, LIS.getNumCallsCrossed(LI0));
+
+        // %1 is killed by the second call.
+        LiveInterval &LI1 =
+            LIS.getInterval(getMI(MF, 1, 0).getOperand(0).getReg());
+        EXPECT_TRUE(LIS.crossesCall(LI1));
+        EXPECT_EQ(1u, LIS.getNumCallsCrossed(LI1));
+
+        // %2 is defined after the last call.
+        LiveInterval &LI2 =
+            LIS.getInterval(getMI(MF, 5, 0).getOperand(0).getReg());
+        EXPECT_FALSE(LIS.crossesCall(LI2));
+        EXPECT_EQ(0u, LIS.getNumCallsCrossed(LI2));
+      });
+}
+
+TEST(LiveIntervalTest, ParallelComputation) {
+  auto *Opt = static_cast<cl::opt<unsigned> *>(
+      cl::getRegisteredOptions().lookup("parallel-live-intervals"));
+  ASSERT_TRUE(Opt);
+  Opt->setValue(1);
+  liveIntervalTest(R"MIR(
+    %0 = IMPLICIT_DEF
+    %1:sreg_64 = IMPLICIT_DEF
+    S_NOP 0, implicit %0
+    %2:sreg_64 = IMPLICIT_DEF
+    %3:sreg_64 = IMPLICIT_DEF
+    S_NOP 0, implicit %1, implicit %3
+)MIR", [](MachineFunction &MF, LiveIntervalsWrapperPass &LISWrapper) {
+    LiveIntervals &LIS = LISWrapper.getLIS();
+    // Recomputing each interval on its own gives the same result.
+    for (unsigned I = 0; I != 4; ++I) {
+      Register Reg = Register::index2VirtReg(I);
+      std::string Parallel, Single;
+      raw_string_ostream ParallelOS(Parallel), SingleOS(Single);
+      ParallelOS << LIS.getInterval(Reg);
+      LIS.removeInterval(Reg);
+      SingleOS << LIS.createAndComputeVirtRegInterval(Reg);
+      EXPECT_EQ(Parallel, Single);
+    }
+    EXPECT_TRUE(getMI(MF, 3, 0).getOperand(0).isDead());
+  });
+  Opt->setValue(0);
+}
+
+TEST(MaxLiveTest, HolesAreNotLive) {
+  maxLiveTest(
+      R"MIR(
+    %0 = IMPLICIT_DEF
+    S_NOP 0, implicit %0
+    %1:sreg_64 = IMPLICIT_DEF
+    %2:sreg_64 = IMPLICIT_DEF
+    S_NOP 0, implicit %1, implicit %2
+    %0 = IMPLICIT_DEF
+    S_NOP 0, implicit %0
+)MIR",
+      [](MachineFunction &MF, MaxLiveWrapperPass &MLWrapper) {
+        const MaxLive &ML = MLWrapper.getMaxLive();
+        const TargetRegisterClass &RC =
+            *MF.getRegInfo().getRegClass(Register::index2VirtReg(0));
+        // %0 has a hole around %1 and %2, so at most two values are live.
+        EXPECT_EQ(2u, ML.getMaxLive(RC));
+        EXPECT_EQ(2u, ML.getMaxLive(*MF.getBlockNumbered(0), RC));
+      });
+}
+
+TEST(LiveIntervalUnionTest, FlatSegments) {
+  liveIntervalTest(R"MIR(
+    %0 = IMPLICIT_DEF
+    %1:sreg_64 = IMPLICIT_DEF
+    S_NOP 0, implicit %0
+    %2:sreg_64 = IMPLICIT_DEF
+    S_NOP 0, implicit %1
+    S_NOP 0, implicit %2
+)MIR", [](MachineFunction &MF, LiveIntervalsWrapperPass &LISWrapper) {
+    LiveIntervals &LIS = LISWrapper.getLIS();
+    const LiveInterval &LI0 = LIS.getInterval(Register::index2VirtReg(0));
+    const LiveInterval &LI1 = LIS.getInterval(Register::index2VirtReg(1));
+    const LiveInterval &LI2 = LIS.getInterval(Register::index2VirtReg(2));
+
+    // %0 and %2 are disjoint, %1 overlaps both. Both storages must give the
+    // same answers.
+    LiveIntervalUnion::Allocator Alloc;
+    for (bool UseFlat : {false, true}) {
+      LiveIntervalUnion LIU(Alloc, UseFlat);
+      LIU.unify(LI2, LI2);
+      LIU.unify(LI0, LI0);
+      EXPECT_EQ(LIU.startIndex(), LI0.beginIndex());
+      EXPECT_EQ(LIU.endIndex(), LI2.endIndex());
+      EXPECT_EQ(LIU.getOneVReg(), &LI0);
+
+      EXPECT_EQ(LIU.isFlat(), UseFlat);
+
+      auto CheckIter = [&](auto I) {
+        ASSERT_TRUE(I.valid());
+        EXPECT_EQ(I.value(), &LI0);
+        I.advanceTo(LI0.endIndex());
+        ASSERT_TRUE(I.valid());
+        EXPECT_EQ(I.value(), &LI2);
+        EXPECT_FALSE((++I).valid());
+      };
+      if (UseFlat)
+        CheckIter(LIU.flatFind(LI1.beginIndex()));
+      else
+        CheckIter(LIU.find(LI1.beginIndex()));
+
+      LiveIntervalUnion::Query Q(LI1, LIU);
+      EXPECT_EQ(Q.interferingVRegs().size(), 2u);
+
+      LIU.extract(LI0, LI0);
+      LiveIntervalUnion::Query Q2(LI1, LIU);
+      ASSERT_EQ(Q2.interferingVRegs().size(), 1u);
+      EXPECT_EQ(Q2.interferingVRegs()[0], &LI2);
+
+      LIU.extract(LI2, LI2);
+      EXPECT_TRUE(LIU.empty());
+    }
+  });
+}
+
+TEST(PackedLiveRangeTest, MatchesLiveRange) {
+  liveIntervalTest(R"MIR(
+    %0 = IMPLICIT_DEF
+    %1:sreg_64 = IMPLICIT_DEF
+    S_NOP 0, implicit %0
+    %2:sreg_64 = IMPLICIT_DEF
+    S_NOP 0, implicit %1
+    S_NOP 0, implicit %2
+)MIR", [](MachineFunction &MF, LiveIntervalsWrapperPass &LISWrapper) {
+    LiveIntervals &LIS = LISWrapper.getLIS();
+    for (unsigned A = 0; A != 3; ++A) {
+      const LiveInterval &LI = LIS.getInterval(Register::index2VirtReg(A));
+      PackedLiveRange PLR(LI);
+      ASSERT_EQ(PLR.size(), LI.size());
+      for (MachineInstr &MI : *MF.begin()) {
+        SlotIndex Idx = LIS.getInstructionIndex(MI);
+        for (SlotIndex Pos : {Idx.getRegSlot(), Idx.getDeadSlot()}) {
+          EXPECT_EQ(PLR.find(Pos), unsigned(LI.find(Pos) - LI.begin()));
+          EXPECT_EQ(PLR.liveAt(Pos), LI.liveAt(Pos));
+        }
+        EXPECT_EQ(PLR.overlaps(Idx, Idx.getDeadSlot()),
+                  LI.overlaps(Idx, Idx.getDeadSlot()));
+      }
+      for (unsigned B = 0; B != 3; ++B) {
+        const LiveInterval &Other =
+            LIS.getInterval(Register::index2VirtReg(B));
+        EXPECT_EQ(PLR.overlaps(PackedLiveRange(Other)), LI.overlaps(Other));
+      }
+    }
+  });
+}
+
+TEST(SlotIndexesTest, RepeatedInsertion) {
+  auto *Opt = static_cast<cl::opt<bool> *>(
+      cl::getRegisteredOptions().lookup("slotindexes-window-renumbering"));
+  ASSERT_TRUE(Opt);
+  for (bool Window : {false, true}) {
+    Opt->setValue(Window);
+    liveIntervalTest(R"MIR(
+    S_NOP 0
+    S_NOP 0
+)MIR", [](MachineFunction &MF, LiveIntervalsWrapperPass &LISWrapper) {
+      LiveIntervals &LIS = LISWrapper.getLIS();
+      MachineInstr &First = getMI(MF, 0, 0);
+      MachineBasicBlock &MBB = *First.getParent();
+
+      // Every new instruction goes right after the first one, into the gap
+      // that the previous one split.
+      for (unsigned I = 0; I != 200; ++I) {
+        MachineInstr *MI = MF.CloneMachineInstr(&First);
+        MBB.insertAfter(First.getIterator(), MI);
+        LIS.InsertMachineInstrInMaps(*MI);
+      }
+
+      SlotIndex Prev = LIS.getMBBStartIdx(&MBB);
+      for (MachineInstr &MI : MBB) {
+        SlotIndex Idx = LIS.getInstructionIndex(MI);
+        EXPECT_LT(Prev, Idx);
+        Prev = Idx;
+      }
+      EXPECT_LT(Prev, LIS.getMBBEndIdx(&MBB));
+    });
+  }
+  Opt->setValue(false);
+}
+
+TEST(SSALivenessTest, LoopAndPHIs) {
+  ssaLivenessTest(
+      R"MIR(
+    successors: %bb.1
+    %0 = IMPLICIT_DEF
+    %1:sreg_64 = IMPLICIT_DEF
+    S_BRANCH %bb.1
+  bb.1:
+    successors: %bb.1, %bb.2
+    %2:sreg_64 = PHI %1, %bb.0, %3, %bb.1
+    %3:sreg_64 = IMPLICIT_DEF implicit %2
+    S_CBRANCH_VCCNZ %bb.1, implicit undef $vcc
+    S_BRANCH %bb.2
+  bb.2:
+    S_NOP 0, implicit %0
+)MIR",
+      [](MachineFunction &MF, SSALivenessWrapperPass &SLWrapper) {
+        const SSALiveness &SL = SLWrapper.getSSALiveness();
+        const MachineBasicBlock &BB0 = *MF.getBlockNumbered(0);
+        const MachineBasicBlock &BB1 = *MF.getBlockNumbered(1);
+        const MachineBasicBlock &BB2 = *MF.getBlockNumbered(2);
+        Register R0 = Register::index2VirtReg(0);
+        Register R1 = Register::index2VirtReg(1);
+        Register R2 = Register::index2VirtReg(2);
+        Register R3 = Register::index2VirtReg(3);
+
+        // %0 is live through the loop to its use after it.
+        EXPECT_TRUE(SL.isLiveOut(R0, BB0));
+        EXPECT_TRUE(SL.isLiveIn(R0, BB1));
+        EXPECT_TRUE(SL.isLiveOut(R0, BB1));
+        EXPECT_TRUE(SL.isLiveIn(R0, BB2));
+        EXPECT_FALSE(SL.isLiveOut(R0, BB2));
+
+        // PHI operands are live out of the incoming block only.
+        EXPECT_TRUE(SL.isLiveOut(R1, BB0));
+        EXPECT_FALSE(SL.isLiveIn(R1, BB1));
+        EXPECT_TRUE(SL.isLiveOut(R3, BB1));
+        EXPECT_FALSE(SL.isLiveIn(R3, BB1));
+        EXPECT_FALSE(SL.isLiveIn(R3, BB2));
+
+        // The PHI is only used in its own block.
+        EXPECT_FALSE(SL.isLiveIn(R2, BB1));
+        EXPECT_FALSE(SL.isLiveOut(R2, BB1));
+      });
+}
+
+TEST(SpillPlacementTest, SaturatingSums) {
+  // Three nested loops that almost never exit. The spread of the block
+  // frequencies doesn't fit in 64 bits, so the inner loop blocks get
+  // frequencies close to the maximum.
+  spillPlacementTest(R"MIR(
+    successors: %bb.1
+    S_BRANCH %bb.1
+  bb.1:
+    successors: %bb.2
+    S_BRANCH %bb.2
+  bb.2:
+    successors: %bb.3
+    S_BRANCH %bb.3
+  bb.3:
+    successors: %bb.4
+    S_BRANCH %bb.4
+  bb.4:
+    successors: %bb.3(0x7fffffff), %bb.5(0x00000001)
+    S_CBRANCH_VCCNZ %bb.3, implicit undef $vcc
+    S_BRANCH %bb.5
+  bb.5:
+    successors: %bb.2(0x7fffffff), %bb.6(0x00000001)
+    S_CBRANCH_VCCNZ %bb.2, implicit undef $vcc
+    S_BRANCH %bb.6
+  bb.6:
+    successors: %bb.1(0x7fffffff), %bb.7(0x00000001)
+    S_CBRANCH_VCCNZ %bb.1, implicit undef $vcc
+    S_BRANCH %bb.7
+  bb.7:
+    S_ENDPGM 0
+)MIR", [](MachineFunction &MF, SpillPlacementWrapperLegacy &SPWrapper) {
+    SpillPlacement &SP = SPWrapper.getResult();
+    using BC = SpillPlacement::BlockConstraint;
+    const SpillPlacement::BorderConstraint DontCare = SpillPlacement::DontCare;
+    const SpillPlacement::BorderConstraint PrefReg = SpillPlacement::PrefReg;
+    const SpillPlacement::BorderConstraint PrefSpill =
+        SpillPlacement::PrefSpill;
+
+    // The links through bb.3 and bb.4 join the same two bundles, and their
+    // weights saturate the sum of the link weights of both.
+    ASSERT_EQ(SP.getBlockFrequency(3) + SP.getBlockFrequency(4),
+              BlockFrequency::max());
+
+    auto Place = [&](ArrayRef<BC> Constraints, ArrayRef<unsigned> Links) {
+      BitVector RegBundles;
+      SP.prepare(RegBundles);
+      SP.addConstraints(Constraints);
+      SP.addLinks(Links);
+      if (SP.scanActiveBundles())
+        SP.iterate();
+      SP.finish();
+      return RegBundles;
+    };
+
+    struct {
+      SmallVector<BC, 4> Constraints;
+      SmallVector<unsigned, 8> Links;
+    } Tests[] = {
+        // Saturated link sums in the inner loop.
+        {{{1, DontCare, PrefReg, false}, {7, PrefSpill, DontCare, false}},
+         {2, 3, 4, 5, 6}},
+        {{{3, PrefSpill, PrefReg, true}, {5, PrefReg, DontCare, false}},
+         {2, 4, 6}},
+        {{{4, PrefReg, PrefSpill, true}, {6, PrefSpill, PrefReg, true}},
+         {1, 2, 3, 5}},
+        // Only the outer loop, where the sums don't saturate.
+        {{{0, DontCare, PrefReg, false}, {7, PrefSpill, DontCare, false}},
+         {1, 6}},
+        {{{1, PrefSpill, PrefReg, true}, {6, PrefReg, PrefSpill, true}},
+         {}},
+    };
+
+    auto *Opt = static_cast<cl::opt<bool> *>(
+        cl::getRegisteredOptions().lookup("spill-placement-saturating-sums"));
+    ASSERT_TRUE(Opt);
+    for (const auto &Test : Tests) {
+      Opt->setValue(false);
+      BitVector Fast = Place(Test.Constraints, Test.Links);
+      Opt->setValue(true);
+      BitVector Saturating = Place(Test.Constraints, Test.Links);
+      EXPECT_TRUE(Fast == Saturating);
+    }
+    Opt->setValue(false);
+  });
+}
+
 TEST(LiveVariablesTest, recomputeForSingleDefVirtReg_handle_undef1) {
   liveVariablesTest(
       R"MIR(
@@ -0,0 +1,122 @@
+//===- llvm/unittests/tools/llc/RegAllocCompareTest.cpp -------------------===//
+//
+// Part of the LLVM Project, under the Apache License v2.0 with LLVM Exceptions.
+// See https://llvm.org/LICENSE.txt for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+//
+//===----------------------------------------------------------------------===//
+
+#include "RegAllocCompare.h"
+#include "llvm/IR/Module.h"
+#include "llvm/MC/TargetRegistry.h"
+#include "llvm/Support/JSON.h"
+#include "llvm/Support/TargetSelect.h"
+#include "llvm/Target/TargetMachine.h"
+#include "llvm/Target/TargetOptions.h"
+#include "llvm/Testing/Support/Error.h"
+#include "llvm/Testing/Support/SupportHelpers.h"
+#include "gtest/gtest.h"
+
+using namespace llvm;
+using llvm::unittest::TempFile;
+
+namespace {
+
+// The vector function gives the RVV allocator and its rewriter some work, so
+// the statistics collector runs after both RISC-V rewriters.
+const char *Input = R"(
+define i64 @add(i64 %a, i64 %b) {
+  %c = add i64 %a, %b
+  ret i64 %c
+}
+
+define void @vadd(ptr %p, ptr %q) {
+  %a = load <vscale x 4 x i32>, ptr %p
+  %b = load <vscale x 4 x i32>, ptr %q
+  %c = add <vscale x 4 x i32> %a, %b
+  store <vscale x 4 x i32> %c, ptr %p
+  ret void
+}
+)";
+
+class RegAllocCompareTest : public testing::Test {
+protected:
+  static void SetUpTestCase() {
+    LLVMInitializeRISCVTargetInfo();
+    LLVMInitializeRISCVTarget();
+    LLVMInitializeRISCVTargetMC();
+    LLVMInitializeRISCVAsmPrinter();
+  }
+
+  void SetUp() override {
+    std::string Error;
+    if (!TargetRegistry::lookupTarget(Triple("riscv64"), Error))
+      GTEST_SKIP();
+  }
+
+  /// Compare \p Allocators on Input, and return the exit code.
+  int compare(ArrayRef<std::string> Allocators, CodeGenOptLevel OptLevel) {
+    TempFile File("regalloc-compare", "ll", Input, /*Unique=*/true);
+    auto CreateTarget = [&](Module &M, std::string &Error)
+        -> std::unique_ptr<TargetMachine> {
+      Triple TT("riscv64");
+      M.setTargetTriple(TT);
+      const Target *T = TargetRegistry::lookupTarget(TT, Error);
+      if (!T)
+        return nullptr;
+      std::unique_ptr<TargetMachine> TM(
+          T->createTargetMachine(TT, "generic-rv64", "+v", TargetOptions(),
+                                 std::nullopt, std::nullopt, OptLevel));
+      M.setDataLayout(TM->createDataLayout());
+      return TM;
+    };
+    Output.clear();
+    raw_string_ostream OS(Output);
+    return compareRegAllocators("llc", {std::string(File.path())}, Allocators,
+                                /*Threads=*/1, CreateTarget, OS);
+  }
+
+  std::string Output;
+};
+
+TEST_F(RegAllocCompareTest, OneEntryPerFunction) {
+  ASSERT_EQ(compare({"greedy", "fast"}, CodeGenOptLevel::Default), 0);
+
+  Expected<json::Value> Result = json::parse(Output);
+  ASSERT_THAT_EXPECTED(Result, Succeeded());
+  const json::Array *Entries = Result->getAsArray();
+  ASSERT_TRUE(Entries);
+
+  // Both rewriters record vadd, and the second record replaces the first.
+  ASSERT_EQ(Entries->size(), 2u);
+  StringRef Functions[] = {"add", "vadd"};
+  for (unsigned I = 0; I != 2; ++I) {
+    const json::Object *Entry = (*Entries)[I].getAsObject();
+    ASSERT_TRUE(Entry);
+    EXPECT_TRUE(Entry->getString("file"));
+    EXPECT_EQ(Entry->getString("function"), Functions[I]);
+    const json::Object *Allocators = Entry->getObject("allocators");
+    ASSERT_TRUE(Allocators);
+    EXPECT_EQ(Allocators->size(), 2u);
+    for (StringRef Allocator : {"greedy", "fast"}) {
+      const json::Object *Stats = Allocators->getObject(Allocator);
+      ASSERT_TRUE(Stats) << Allocator;
+      for (StringRef Key : {"spills", "reloads", "copies"})
+        EXPECT_TRUE(Stats->getInteger(Key)) << Allocator << ' ' << Key;
+      for (StringRef Key : {"score", "time_ms"})
+        EXPECT_TRUE(Stats->getNumber(Key)) << Allocator << ' ' << Key;
+    }
+  }
+}
+
+TEST_F(RegAllocCompareTest, RejectsO0) {
+  EXPECT_EQ(compare({"greedy", "fast"}, CodeGenOptLevel::None), 1);
+  EXPECT_TRUE(Output.empty());
+}
+
+TEST_F(RegAllocCompareTest, RejectsUnknownAllocator) {
+  EXPECT_EQ(compare({"greedy", "nonexistent"}, CodeGenOptLevel::Default), 1);
+  EXPECT_TRUE(Output.empty());
+}
+
+} // namespace
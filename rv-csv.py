@@ -78,7 +78,7 @@ def count_unique_registers(asm_file):
 def parse_ssa_report(stderr_output, file_name):
     """
     Parses lines like:
-    @SSA_REPORT func=main class=GPR spills=2 pressure=15
+    @SSA_REPORT func=main class=GPR spills=2 pressure=15 csrs=3 csr_cost=6.00
     """
     total_spills = 0
     max_pressure = 0
@@ -115,6 +115,8 @@ def run_benchmark(file_path, run_cmd, alloc_mode):
     
     # --- CHANGE: Inject the MATTR flag to increase pressure ---
     cmd = f"{cmd} {LLC_MATTR} -stats -o {TEMP_ASM}"
+    if alloc_mode == "ssa":
+        cmd = f"{cmd} -ssa-regalloc-report"
     
     try:
         # Run process